@@ -0,0 +1,292 @@
+/*
+Benchmark.cpp
+
+Runs the reconstruction stages over a matrix of point clouds and grid sizes
+without a window and writes the timings as JSON.
+
+Each point cloud is loaded once.  Every repetition then runs setup, tangent
+planes and orientation once and the contour for each grid size, so the
+stages that do not depend on the grid size are not repeated per grid size.
+The first warmup repetitions are run but not recorded.
+With -verify the k nearest searches of the point index, and of a dynamic
+index on a sparse fine grid, are first checked against a brute-force search
+over the points of each input.
+With -cache only the first repetition ever estimates and orients the
+tangent planes of an input, the later ones (and later runs) load them.
+
+For every stage the report has the median, 95th percentile, min and max in
+milliseconds and the raw samples.  Contour entries also carry the grid size
+and the face count of the mesh.
+*/
+
+#include "includes/includes.hpp"
+#include "PointCloud.hpp"
+#include "Reconstruction.hpp"
+using namespace HuguesHoppe;
+
+struct StageTimes
+{
+	std::string stage;
+	int gridsize; // 0 for stages that do not depend on it
+	int faces;
+	std::vector<double> samples;
+};
+
+struct InputTimes
+{
+	std::string file;
+	int vertices;
+	bool fileNormals;
+	std::vector<StageTimes> stages;
+};
+
+void usage(const char* program)
+{
+	printf("usage:  %s [options]\n", program);
+	printf("  -i file             point cloud, repeat for more (src/sphere1k.pcd)\n");
+	printf("  -g n                grid size, repeat for more (10 20 50)\n");
+	printf("  -warmup n           unrecorded repetitions (1)\n");
+	printf("  -reps n             recorded repetitions (5)\n");
+	printf("  -kmin n             minimum points in a tangent plane (%d)\n", minkintp);
+	printf("  -kmax n             maximum points in a tangent plane (%d)\n", maxkintp);
+	printf("  -t n                worker threads (%d)\n", threadCount());
+	printf("  -spatial name       nearest point index, grid or kdtree (%s)\n", spatialIndexName(spatialIndex));
+	printf("  -morton             reorder the points along a Morton curve for locality\n");
+	printf("  -eps x              approximate nearest searches, up to 1+x times farther (%g)\n", searchEpsilon);
+	printf("  -cache dir          reuse the oriented tangent planes cached in dir\n");
+	printf("  -estimate-normals   ignore normals in the input files\n");
+	printf("  -verify             check the nearest point searches against brute force\n");
+	printf("  -o file             JSON report (benchmark.json)\n");
+	printf("  -stats file         JSON report of stage timers and counters over all runs\n");
+}
+
+// Quote and escape a string for the JSON report (file names may hold backslashes)
+std::string jsonString(const std::string& str)
+{
+	std::string quoted = "\"";
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\') quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+void writeSamples(FILE* fileOut, const std::vector<double>& samples)
+{
+	fprintf(fileOut, "[");
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		fprintf(fileOut, "%s%.3f", i ? ", " : "", samples[i]);
+	}
+	fprintf(fileOut, "]");
+}
+
+// Compare the kmax nearest points found by sp for a sample of queries near the points with those of a brute-force
+// search over the first n points, those entered into sp; returns the number of queries whose distances differ.
+int verifyNearest(const Spatial& sp, int n)
+{
+	const int k = maxkintp, nq = std::min(numVertices, 256);
+	glm::vec3 offset = (pcBoxBound[1] - pcBoxBound[0]) * 0.01f;
+	std::vector<glm::vec3> queries(nq);
+	for (int q = 0; q < nq; q++)
+	{
+		glm::vec3 query = points[size_t(q) * numVertices / nq] + offset * float(q % 3 - 1);
+		for_int(c, 3) { query[c] = clamp(query[c], pcBoxBound[0][c], pcBoxBound[1][c]); }
+		queries[q] = query;
+	}
+	std::vector<int> ids(size_t(nq) * k);
+	std::vector<float> dis2(size_t(nq) * k);
+	sp.knn(nq, queries.data(), k, ids.data(), dis2.data());
+	int nbad = 0;
+	std::vector<float> all(n);
+	for (int q = 0; q < nq; q++)
+	{
+		for (int i = 0; i < n; i++) { glm::vec3 d = points[i] - queries[q]; all[i] = glm::dot(d, d); }
+		int m = std::min(n, k);
+		std::partial_sort(all.begin(), all.begin() + m, all.end());
+		bool bad = false;
+		for (int j = 0; j < k; j++)
+		{
+			float expected = j < m ? all[j] : BIGFLOAT;
+			bad = bad || std::abs(dis2[size_t(q) * k + j] - expected) > 1e-5f * (expected + glm::dot(offset, offset));
+		}
+		nbad += bad;
+	}
+	return nbad;
+}
+
+// Check against brute force the searches of the point index (made exact) and those of a DynamicPointSpatial on a
+// fine grid over a box 4 times the bounds, mostly empty cells, before and after the points are entered.
+bool verifySearches(const char* file)
+{
+	SPp->set_epsilon(0.f);
+	int nbad = verifyNearest(*SPp, numVertices);
+	SPp->set_epsilon(searchEpsilon);
+	printf("%s:  %d of the sampled %s nearest searches differ from brute force\n", file, nbad, spatialIndexName(spatialIndex));
+	glm::vec3 size = pcBoxBound[1] - pcBoxBound[0];
+	DynamicPointSpatial dynamic(2 * GridPointSpatial::k_max_dense_gn, Vec2<glm::vec3>(pcBoxBound[0] - size * 1.5f, pcBoxBound[1] + size * 1.5f));
+	int dynbad = verifyNearest(dynamic, 0);
+	std::vector<int> ids(numVertices);
+	for_int(i, numVertices) { ids[i] = i; }
+	dynamic.enter(numVertices, ids.data(), points);
+	dynbad += verifyNearest(dynamic, numVertices);
+	printf("%s:  %d of the sampled sparse dynamic grid nearest searches differ from brute force\n", file, dynbad);
+	return nbad == 0 && dynbad == 0;
+}
+
+bool writeReport(const char* fileName, const std::vector<InputTimes>& inputs, int warmup, int reps)
+{
+	FILE* fileOut = fopen(fileName, "w");
+	if (fileOut == NULL)
+	{
+		printf("writeReport error:  can't open %s\n", fileName);
+		return false;
+	}
+
+	fprintf(fileOut, "{\n  \"threads\": %d,\n  \"warmup\": %d,\n  \"repetitions\": %d,\n", threadCount(), warmup, reps);
+	fprintf(fileOut, "  \"distance_kernel\": \"%s\",\n", spatial_kernel_name(spatial_kernel()));
+	fprintf(fileOut, "  \"kmin\": %d,\n  \"kmax\": %d,\n  \"spatial\": \"%s\",\n  \"morton\": %s,\n  \"eps\": %g,\n",
+		minkintp, maxkintp, spatialIndexName(spatialIndex), mortonOrder ? "true" : "false", searchEpsilon);
+	fprintf(fileOut, "  \"cache\": %s,\n  \"inputs\": [",
+		tangentPlaneCacheDir != NULL ? jsonString(tangentPlaneCacheDir).c_str() : "null");
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		const InputTimes& input = inputs[i];
+		fprintf(fileOut, "%s\n    {\n      \"file\": %s,\n      \"vertices\": %d,\n      \"file_normals\": %s,\n      \"stages\": [",
+			i ? "," : "", jsonString(input.file).c_str(), input.vertices, input.fileNormals ? "true" : "false");
+		for (size_t j = 0; j < input.stages.size(); j++)
+		{
+			const StageTimes& stage = input.stages[j];
+			fprintf(fileOut, "%s\n        { \"stage\": \"%s\", ", j ? "," : "", stage.stage.c_str());
+			if (stage.gridsize > 0) fprintf(fileOut, "\"gridsize\": %d, \"faces\": %d, ", stage.gridsize, stage.faces);
+			std::vector<double>::const_iterator minmax[2] = {
+				std::min_element(stage.samples.begin(), stage.samples.end()),
+				std::max_element(stage.samples.begin(), stage.samples.end()) };
+			fprintf(fileOut, "\"median_ms\": %.3f, \"p95_ms\": %.3f, \"min_ms\": %.3f, \"max_ms\": %.3f, \"samples_ms\": ",
+				median(stage.samples), percentile(stage.samples, 95.0),
+				stage.samples.empty() ? 0.0 : *minmax[0], stage.samples.empty() ? 0.0 : *minmax[1]);
+			writeSamples(fileOut, stage.samples);
+			fprintf(fileOut, " }");
+		}
+		fprintf(fileOut, "\n      ]\n    }");
+	}
+	fprintf(fileOut, "\n  ]\n}\n");
+
+	bool ok = fclose(fileOut) == 0;
+	if (!ok) printf("writeReport error:  failed writing %s\n", fileName);
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<char*> inputFiles;
+	std::vector<int> gridsizes;
+	int warmup = 1, reps = 5;
+	bool useFileNormals = true, verify = false;
+	const char* reportFile = "benchmark.json";
+	const char* statsFile = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(arg, "-i") == 0 && hasValue) inputFiles.push_back(argv[++i]);
+		else if (strcmp(arg, "-g") == 0 && hasValue) gridsizes.push_back(atoi(argv[++i]));
+		else if (strcmp(arg, "-warmup") == 0 && hasValue) warmup = atoi(argv[++i]);
+		else if (strcmp(arg, "-reps") == 0 && hasValue) reps = atoi(argv[++i]);
+		else if (strcmp(arg, "-kmin") == 0 && hasValue) minkintp = atoi(argv[++i]);
+		else if (strcmp(arg, "-kmax") == 0 && hasValue) maxkintp = atoi(argv[++i]);
+		else if (strcmp(arg, "-t") == 0 && hasValue) setThreadCount(atoi(argv[++i]));
+		else if (strcmp(arg, "-spatial") == 0 && hasValue) spatialIndex = spatialIndexFromName(argv[++i]);
+		else if (strcmp(arg, "-morton") == 0) mortonOrder = true;
+		else if (strcmp(arg, "-eps") == 0 && hasValue) searchEpsilon = float(atof(argv[++i]));
+		else if (strcmp(arg, "-cache") == 0 && hasValue) tangentPlaneCacheDir = argv[++i];
+		else if (strcmp(arg, "-estimate-normals") == 0) useFileNormals = false;
+		else if (strcmp(arg, "-verify") == 0) verify = true;
+		else if (strcmp(arg, "-o") == 0 && hasValue) reportFile = argv[++i];
+		else if (strcmp(arg, "-stats") == 0 && hasValue) statsFile = argv[++i];
+		else
+		{
+			printf("unknown or incomplete argument %s\n", arg);
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (inputFiles.empty()) inputFiles.push_back((char*)"src/sphere1k.pcd");
+	if (gridsizes.empty()) gridsizes = { 10, 20, 50 };
+	bool valid = warmup >= 0 && reps >= 1 && minkintp >= 1 && maxkintp >= minkintp && spatialIndex != SPATIAL_INVALID && searchEpsilon >= 0.f;
+	for (int g : gridsizes) { valid = valid && g >= 1; }
+	if (!valid)
+	{
+		printf("invalid arguments\n");
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<InputTimes> inputs;
+	for (char* file : inputFiles)
+	{
+		PointCloud pointCloud(file);
+		if (pointCloud.Vertices() <= 0)
+		{
+			printf("benchmark error:  no points loaded from %s\n", file);
+			return 1;
+		}
+
+		const glm::vec3* normals = useFileNormals ? pointCloud.NormalData() : NULL;
+		InputTimes input = { file, pointCloud.Vertices(), normals != NULL, std::vector<StageTimes>() };
+		input.stages.push_back(StageTimes{ "setup", 0, 0, std::vector<double>() });
+		input.stages.push_back(StageTimes{ "tangent_planes", 0, 0, std::vector<double>() });
+		input.stages.push_back(StageTimes{ "orientation", 0, 0, std::vector<double>() });
+		for (int g : gridsizes) { input.stages.push_back(StageTimes{ "contour", g, 0, std::vector<double>() }); }
+
+		if (verify)
+		{
+			setup_reconstruction(pointCloud.Vertices(), pointCloud.PointData(),
+				Vec2<glm::vec3>(pointCloud.MinBound(), pointCloud.MaxBound()));
+			if (!verifySearches(file)) return 1;
+		}
+
+		for (int rep = 0; rep < warmup + reps; rep++)
+		{
+			bool record = rep >= warmup;
+			double time = elapsedTime();
+			setup_reconstruction(pointCloud.Vertices(), pointCloud.PointData(),
+				Vec2<glm::vec3>(pointCloud.MinBound(), pointCloud.MaxBound()));
+			double setupTime = elapsedTime() - time;
+			time = elapsedTime();
+			compute_tangent_planes(normals);
+			double tpTime = elapsedTime() - time;
+			time = elapsedTime();
+			orient_tangent_planes();
+			double orientTime = elapsedTime() - time;
+			if (record)
+			{
+				input.stages[0].samples.push_back(setupTime);
+				input.stages[1].samples.push_back(tpTime);
+				input.stages[2].samples.push_back(orientTime);
+			}
+
+			for (size_t g = 0; g < gridsizes.size(); g++)
+			{
+				gridsize = gridsizes[g];
+				time = elapsedTime();
+				contour_tangent_planes();
+				double contourTime = elapsedTime() - time;
+				StageTimes& contour = input.stages[3 + g];
+				contour.faces = mesh.num_faces();
+				if (record) contour.samples.push_back(contourTime);
+				printf("%s rep %d%s gridsize %d:  setup %.1f  tangent planes %.1f  orientation %.1f  contour %.1f ms\n",
+					file, rep, record ? "" : " (warmup)", gridsize, setupTime, tpTime, orientTime, contourTime);
+			}
+		}
+
+		mesh.clear();
+		inputs.push_back(input);
+	}
+
+	if (statsFile != NULL && !writeStats(statsFile)) return 1;
+	return writeReport(reportFile, inputs, warmup, reps) ? 0 : 1;
+}
@@ -22,11 +22,15 @@ namespace HuguesHoppe
 		{
 			_vertex_tol = tol;
 		}
+		size_t memory_usage() const // estimated heap bytes of the grid nodes and cube queue
+		{
+			return hashBytes(_m) + _queue.size() * sizeof(uint64_t);
+		}
 	protected:
 		static constexpr float k_not_yet_evaled = BIGFLOAT;
 		using DPoint = glm::vec3; // domain point
 		using IPoint = glm::ivec3;   // grid point
-		static constexpr int k_max_gn = 1024; // bits/coordinate==10 for 3D, 16
+		static constexpr int k_max_gn = 1 << mortonBits; // 21 bits/coordinate in a 64-bit key
 		ContourBase(int gn, const Vec2<glm::vec3>& boxBound) : 
 			_gn(gn), _gni(1.f / gn), _boxBounds(boxBound)
 		{
@@ -37,16 +41,13 @@ namespace HuguesHoppe
 		~ContourBase()
 		{
 			assert(_queue.empty());
-			if (true)
-			{
-				printf("March:\n");
-				printf("visited %d cubes (%d were undefined, %d contained nothing)\n",
-					_ncvisited, _ncundef, _ncnothing);
-				printf("evaluated %d vertices (%d were zero, %d were undefined)\n",
-					_nvevaled, _nvzero, _nvundef);
-				printf("encountered %d tough edges\n",
-					_nedegen);
-			}
+			addStat("contour_cubes_visited", _ncvisited);
+			addStat("contour_cubes_undefined", _ncundef);
+			addStat("contour_cubes_nothing", _ncnothing);
+			addStat("contour_vertices_evaluated", _nvevaled);
+			addStat("contour_vertices_zero", _nvzero);
+			addStat("contour_vertices_undefined", _nvundef);
+			addStat("contour_tough_edges", _nedegen);
 		}
 
 		int _gn;
@@ -59,21 +60,21 @@ namespace HuguesHoppe
 									 // So there are no "+.5f" roundings anywhere in the code.
 		struct Node : VertexData
 		{
-			explicit Node(unsigned pen) : _en(pen) { }
+			explicit Node(uint64_t pen) : _en(pen) { }
 			enum class ECubestate { nothing, queued, visited };
-			unsigned _en;                                // encoded vertex index
+			uint64_t _en;                                // encoded vertex index (Morton key)
 			ECubestate _cubestate{ ECubestate::nothing }; // cube info
 			float _val{ k_not_yet_evaled };               // vertex value
 			DPoint _p;                                   // vertex point position in grid
 														 // Note that for 3D, base class contains Vec3<Vertex> _verts.
 		};
 
-		struct hash_Node { size_t operator()(const Node& n) const { return n._en; } };
+		struct hash_Node { size_t operator()(const Node& n) const { return size_t(n._en); } };
 		struct equal_Node { bool operator()(const Node& n1, const Node& n2) const { return n1._en == n2._en; } };
 		std::unordered_set<Node, hash_Node, equal_Node> _m;
 		// (std::unordered_set<> : References and pointers to key stored in the container are only
 		//   invalidated by erasing that element.  So it's OK to keep pointers to Node* even as more are added.)
-		std::queue<unsigned> _queue;     // cubes queued to be visited
+		std::queue<uint64_t> _queue;     // cubes queued to be visited
 		int _ncvisited{ 0 };
 		int _ncundef{ 0 };
 		int _ncnothing{ 0 };
@@ -204,16 +205,15 @@ namespace HuguesHoppe
 			using Node222 = Vec2<Vec2<Vec2<Node*>>>;
 			using base::k_not_yet_evaled;
 			//
-			unsigned encode(const IPoint& ci) const
+			uint64_t encode(const IPoint& ci) const
 			{
-				assert(k_max_gn <= 1024);
-				return (((unsigned(ci[0]) << 10) | unsigned(ci[1])) << 10) | unsigned(ci[2]);
+				return mortonEncode(uint32_t(ci[0]), uint32_t(ci[1]), uint32_t(ci[2]));
 			}
 
-			IPoint decode(unsigned en) const
+			IPoint decode(uint64_t en) const
 			{
-				assert(k_max_gn <= 1024);
-				return IPoint(int(en >> 20), int((en >> 10)&((1u << 10) - 1)), int(en&((1u << 10) - 1)));
+				uint32_t x, y, z; mortonDecode(en, x, y, z);
+				return IPoint(int(x), int(y), int(z));
 			}
 
 			int float_to_index(int axis, float fd) const
@@ -262,7 +262,7 @@ namespace HuguesHoppe
 			{
 				int oncvisited = _ncvisited;
 				{
-					unsigned en = encode(cc);
+					uint64_t en = encode(cc);
 					auto p = _m.insert(Node(en));
 					bool is_new = p.second;
 					Node* n = const_cast<Node*>(&*p.first);
@@ -274,7 +274,7 @@ namespace HuguesHoppe
 				}
 				while (!_queue.empty())
 				{
-					unsigned en = _queue.front();
+					uint64_t en = _queue.front();
 					_queue.pop();
 					consider_cube(en); // BREAKPOINT
 				}
@@ -283,7 +283,7 @@ namespace HuguesHoppe
 				return cncvisited;
 			}
 
-			void consider_cube(unsigned encube)
+			void consider_cube(uint64_t encube)
 			{
 				_ncvisited++;
 				IPoint cc = decode(encube);
@@ -293,7 +293,7 @@ namespace HuguesHoppe
 				{
 					IPoint cd(i, j, k);
 					IPoint ci = cc + cd;
-					unsigned en = encode(ci);
+					uint64_t en = encode(ci);
 					auto p = _m.insert(Node(en));
 					bool is_new = p.second;
 					Node* n = const_cast<Node*>(&*p.first);
@@ -344,7 +344,7 @@ namespace HuguesHoppe
 										  // note: vmin<0 since 0 is arbitrarily taken to be positive
 					if (vmax != k_Contour_undefined && vmin<0 && vmax >= 0 && cube_inbounds(ci))
 					{
-						unsigned en = encode(ci);
+						uint64_t en = encode(ci);
 						auto p = _m.insert(Node(en));
 						bool is_new = p.second;
 						Node* n2 = const_cast<Node*>(&*p.first);
@@ -31,11 +31,13 @@ namespace HuguesHoppe
 		bool remove(T v);           // must have 0 out_degree, ret: was_there
 									// enter an edge
 		void enter(T v1, T v2) { assert(!contains(v1, v2)); _m.at(v1).push_back(v2); }
+		// set all the outgoing edges of v, which has none; may run concurrently for distinct vertices
+		void assign_edges(T v, atype&& ar) { atype& a = _m.at(v); assert(a.empty()); a = std::move(ar); }
 		// enter undirected edge
 		void enter_undirected(T v1, T v2) { enter(v1, v2); enter(v2, v1); } // v1 & v2 present; new edge
 		bool contains(T v1, T v2)
 		{
-			std::vector<T> a = _m.at(v1);
+			const atype& a = _m.at(v1);
 			auto it = find(a, v2);
 			if (it != a.end()) return true;
 			return false;
@@ -52,6 +54,12 @@ namespace HuguesHoppe
 		vertices_range vertices() const { return vertices_range(_m); }
 		edges_range edges(T v) const { return _m.at(v); }
 		friend void swap(Graph& l, Graph& r) noexcept { using std::swap; swap(l._m, r._m); }
+		size_t memory_usage() const // estimated heap bytes
+		{
+			size_t bytes = hashBytes(_m);
+			for (const auto& p : _m) { bytes += vectorBytes(p.second); }
+			return bytes;
+		}
 	public:
 		class vertex_iterator : public std::iterator<std::forward_iterator_tag, const T>
 		{
@@ -149,7 +157,11 @@ namespace HuguesHoppe
 			if (neadded == nv - 1) break;
 		}
 
-		printf("graph_mst: %d vertices, %d/%d edges considered, %d output\n", nv, neconsidered, nebefore, neadded);
+		addStat("graph_mst_calls", 1);
+		addStat("graph_mst_vertices", nv);
+		addStat("graph_mst_edges_input", nebefore);
+		addStat("graph_mst_edges_considered", neconsidered);
+		addStat("graph_mst_edges_output", neadded);
 		return neadded == nv - 1;
 	}
 } // namespace hh
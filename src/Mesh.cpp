@@ -88,6 +88,32 @@ namespace HuguesHoppe
 		delete f;
 	}
 
+	void Mesh::clear()
+	{
+		for (Face f : facesVector()) { destroy_face(f); }
+		_id2face.clear();
+		for (Vertex v : vertices()) { delete v; }
+		_id2vertex.clear();
+		_vertexnum = 1;
+		_facenum = 1;
+		assert(_nedges == 0);
+	}
+
+	size_t Mesh::memory_usage() const
+	{
+		size_t bytes = hashBytes(_id2vertex) + hashBytes(_id2face);
+		size_t nhedges = 0;
+		for (Vertex v : vertices())
+		{
+			bytes += sizeof(MVertex) + heapObjectBytes + vectorBytes(v->_arhe);
+			nhedges += v->_arhe.size();
+		}
+		bytes += _id2face.size() * (sizeof(MFace) + heapObjectBytes);
+		bytes += nhedges * (sizeof(MHEdge) + heapObjectBytes);
+		bytes += _nedges * (sizeof(MEdge) + heapObjectBytes);
+		return bytes;
+	}
+
 	// *** Face
 
 	void Mesh::get_vertices(Face f, std::vector<Vertex>& va) const
@@ -36,6 +36,9 @@ namespace HuguesHoppe
 		public:
 			cvalues_iterator() = default;
 			cvalues_iterator(typename std::unordered_map<int, T>::const_iterator it) : _it(it) { }
+			bool operator!=(const cvalues_iterator& rhs) const { return _it != rhs._it; }
+			const T& operator*() const { return _it->second; }
+			cvalues_iterator& operator++() { ++_it; return *this; }
 		private:
 			typename std::unordered_map<int, T>::const_iterator _it;
 		};
@@ -43,6 +46,8 @@ namespace HuguesHoppe
 		{
 		public:
 			cvalues_range(const std::unordered_map<int, T>& t) : _t(t) { }
+			cvalues_iterator<T> begin() const { return cvalues_iterator<T>(_t.begin()); }
+			cvalues_iterator<T> end() const { return cvalues_iterator<T>(_t.end()); }
 		private:
 			const std::unordered_map<int, T>& _t;
 		};
@@ -53,7 +58,9 @@ namespace HuguesHoppe
 		struct EF_range;
 	public:
 		Mesh() {}
-		virtual ~Mesh() {}
+		virtual ~Mesh() { clear(); }
+		// Destroy all faces and vertices.
+		void clear();
 
 		// Raw manipulation functions, may lead to non-nice Meshes.
 		// always legal
@@ -115,9 +122,17 @@ namespace HuguesHoppe
 		virtual Vertex center_split_face(Face f); // always legal
 
 		// Mesh
+		int num_vertices() const {
+			return int(_id2vertex.size());
+		}
+		int num_faces() const {
+			return int(_id2face.size());
+		}
 		int vertex_id(Vertex v) const {
 			return v->id;
 		}
+		// Estimated heap bytes of the id maps and of the vertex, face, half-edge and edge objects.
+		size_t memory_usage() const;
 
 									// Iterators; can crash if continued after any change in the Mesh.
 									// These mesh iterators do not define an order.
@@ -126,6 +141,11 @@ namespace HuguesHoppe
 			get_values<int, Face>(_id2face, faces);
 			return faces;
 		}
+		// Ranges over the mesh elements without copying them.
+		Vertices_range vertices() const {
+			return Vertices_range(_id2vertex); }
+		Faces_range faces() const {
+			return Faces_range(_id2face); }
 		// Face iterators all go CCW
 		FV_range vertices(Face f) const {
 			return FV_range(*this, f); }
@@ -0,0 +1,123 @@
+#include "MeshIO.hpp"
+
+namespace HuguesHoppe
+{
+	namespace
+	{
+		// Output file with a large write buffer; remembers the first failure.
+		class BufferedFile : noncopyable
+		{
+		public:
+			explicit BufferedFile(const char* fileName, const char* mode) : _buf(k_size)
+			{
+				_f = fopen(fileName, mode);
+				if (!_f) printf("write_mesh error:  can't open %s\n", fileName);
+			}
+			~BufferedFile() { close(); }
+			bool ok() const { return _f && _ok; }
+			void write(const void* data, size_t size)
+			{
+				if (_n + size > _buf.size()) flush();
+				if (size > _buf.size()) { _ok = _ok && fwrite(data, 1, size, _f) == size; return; }
+				memcpy(_buf.data() + _n, data, size);
+				_n += size;
+			}
+			template<typename T> void write_value(const T& value) { write(&value, sizeof(T)); }
+			template<typename... Args> void print(const char* format, Args... args)
+			{
+				if (_n + k_max_line > _buf.size()) flush();
+				int len = snprintf(_buf.data() + _n, k_max_line, format, args...);
+				assert(len >= 0 && len < k_max_line);
+				_n += len;
+			}
+			bool close()
+			{
+				if (!_f) return false;
+				flush();
+				_ok = fclose(_f) == 0 && _ok;
+				_f = nullptr;
+				return _ok;
+			}
+		private:
+			static constexpr size_t k_size = 1 << 22;
+			static constexpr int k_max_line = 256;
+			FILE* _f;
+			std::vector<char> _buf;
+			size_t _n{ 0 };
+			bool _ok{ true };
+			void flush()
+			{
+				if (_n && _f) _ok = _ok && fwrite(_buf.data(), 1, _n, _f) == _n;
+				_n = 0;
+			}
+		};
+
+		// Map from vertex id to output index (0-based, in mesh.vertices() order).
+		std::vector<int> vertex_indices(const Mesh& mesh)
+		{
+			int maxid = 0;
+			for (Vertex v : mesh.vertices()) { maxid = std::max(maxid, mesh.vertex_id(v)); }
+			std::vector<int> index(maxid + 1, -1);
+			int i = 0;
+			for (Vertex v : mesh.vertices()) { index[mesh.vertex_id(v)] = i++; }
+			return index;
+		}
+	}
+
+	bool write_mesh_ply(const Mesh& mesh, const char* fileName)
+	{
+		BufferedFile file(fileName, "wb");
+		if (!file.ok()) return false;
+		std::vector<int> index = vertex_indices(mesh);
+		file.print("ply\nformat binary_little_endian 1.0\n");
+		file.print("element vertex %d\nproperty float x\nproperty float y\nproperty float z\n", mesh.num_vertices());
+		file.print("element face %d\nproperty list uchar int vertex_indices\nend_header\n", mesh.num_faces());
+		for (Vertex v : mesh.vertices())
+		{
+			file.write(&v->point[0], 3 * sizeof(float));
+		}
+		for (Face f : mesh.faces())
+		{
+			int nv = 0;
+			for (Vertex v : mesh.vertices(f)) { dummy_use(v); nv++; }
+			assert(nv < 256);
+			file.write_value(uint8_t(nv));
+			for (Vertex v : mesh.vertices(f)) { file.write_value(int32_t(index[mesh.vertex_id(v)])); }
+		}
+		bool ok = file.close();
+		if (!ok) printf("write_mesh error:  failed writing %s\n", fileName);
+		else printf("wrote %s with %d vertices and %d faces\n", fileName, mesh.num_vertices(), mesh.num_faces());
+		return ok;
+	}
+
+	bool write_mesh_obj(const Mesh& mesh, const char* fileName)
+	{
+		BufferedFile file(fileName, "w");
+		if (!file.ok()) return false;
+		std::vector<int> index = vertex_indices(mesh);
+		for (Vertex v : mesh.vertices())
+		{
+			file.print("v %.9g %.9g %.9g\n", v->point.x, v->point.y, v->point.z);
+		}
+		for (Face f : mesh.faces())
+		{
+			file.print("f");
+			for (Vertex v : mesh.vertices(f)) { file.print(" %d", index[mesh.vertex_id(v)] + 1); }
+			file.print("\n");
+		}
+		bool ok = file.close();
+		if (!ok) printf("write_mesh error:  failed writing %s\n", fileName);
+		else printf("wrote %s with %d vertices and %d faces\n", fileName, mesh.num_vertices(), mesh.num_faces());
+		return ok;
+	}
+
+	bool write_mesh(const Mesh& mesh, const char* fileName)
+	{
+		std::string file = fileName;
+		size_t f = file.find_last_of('.');
+		std::string extension = f == std::string::npos ? "" : file.substr(f);
+		if (StringICompare(extension, ".obj")) return write_mesh_obj(mesh, fileName);
+		return write_mesh_ply(mesh, fileName);
+	}
+
+} // namespace HuguesHoppe
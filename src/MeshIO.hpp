@@ -0,0 +1,23 @@
+#ifndef MESH_IO_H
+#define MESH_IO_H
+
+#include "includes/includes.hpp"
+#include "Mesh.hpp"
+
+namespace HuguesHoppe
+{
+	// Streaming export of a Mesh as indexed vertices and faces.
+	// Vertices and faces are visited in place (no copy of the face set) and written
+	// through a large buffer, so multi-million face meshes are written in a few big writes.
+	// Vertices are renumbered 0..n-1 in the order they are visited; faces keep their ccw order.
+
+	// Binary little-endian PLY: float x y z per vertex, uchar count + int indices per face.
+	bool write_mesh_ply(const Mesh& mesh, const char* fileName);
+	// Wavefront OBJ text: "v x y z" and "f i j k" lines, 1-based indices.
+	bool write_mesh_obj(const Mesh& mesh, const char* fileName);
+	// Picks the format from the file extension (.obj, anything else is PLY).
+	bool write_mesh(const Mesh& mesh, const char* fileName);
+
+} // namespace HuguesHoppe
+
+#endif // MESH_IO_H
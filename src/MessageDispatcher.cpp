@@ -1,3 +1,4 @@
+#include "includes/includesGL.hpp"
 #include "MessageDispatcher.hpp"
 #include "BaseEntity.hpp"
 #include "Scene.hpp"
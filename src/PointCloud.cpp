@@ -1,20 +1,22 @@
 #include "PointCloud.hpp"
-#include "Scene.hpp"
 
 PointCloud::PointCloud(char* modelFile,
-             GLuint* VAO, GLuint* buffer, GLuint* shaderProgram) :
+             unsigned int* VAO, unsigned int* buffer, unsigned int* shaderProgram) :
     m_gliVAO(VAO),
     m_gliBuffer(buffer),
     m_gliShaderProgram(shaderProgram),
     m_fBoundingRadius(0.0),
 	m_vPoints(new std::vector<glm::vec3>()),
+	m_vNormals(new std::vector<glm::vec3>()),
+	m_pMappedFile(NULL),
+	m_pPointData(NULL),
+	m_pNormalData(NULL),
 	m_vMinBound(glm::vec3()),
 	m_vMaxBound(glm::vec3())
 {
     size_t size = strlen(modelFile) + 1;
     m_cFile = new char[size];
     strncpy(m_cFile, modelFile, size);
-	m_vPoints = new std::vector<glm::vec3>();
     Init();
 
 	// shorten name
@@ -26,23 +28,55 @@ PointCloud::PointCloud(char* modelFile,
 	delete[] m_cFile;
 	m_cFile = new char[size];
 	strncpy(m_cFile, file.c_str(), size);
-
-    Scene::Instance()->AddPointCloud(this);
 }
 
 void PointCloud::Init()
 {
-    float* returned = loadPointCloud(m_cFile,
-                                        *m_gliVAO, *m_gliBuffer, *m_gliShaderProgram, GLuint(), GLuint(), GLuint(),
-                                        m_vPoints, m_vMinBound, m_vMaxBound);
-	m_fBoundingRadius = returned[0];
-	m_iVertices = (int)returned[1];
+	// Load positions and bounds on the CPU only
+	// Binary point clouds are used in place, no parsing or copying
+	m_pMappedFile = new MappedFile(m_cFile);
+	if (isPointCloudBinary(*m_pMappedFile, m_cFile))
+	{
+		// A *.pcb file that does not validate is a load error, not a text file
+		const PointCloudBinaryHeader* header = readPointCloudBinary(*m_pMappedFile);
+		if (header == NULL)
+		{
+			printf("PointCloud error:  can't load %s as a binary point cloud\n", m_cFile);
+			delete m_pMappedFile;
+			m_pMappedFile = NULL;
+			m_iVertices = 0;
+			return;
+		}
+		m_iVertices = (int)header->count;
+		m_fBoundingRadius = header->boundingRadius;
+		m_vMinBound = glm::vec3(header->min[0], header->min[1], header->min[2]);
+		m_vMaxBound = glm::vec3(header->max[0], header->max[1], header->max[2]);
+		m_pPointData = pointCloudBinaryPoints(header);
+		m_pNormalData = pointCloudBinaryNormals(header);
+		printf("loaded %s model with %7.2f bounding radius and %d vertices\n", m_cFile, m_fBoundingRadius, m_iVertices);
+	}
+	else
+	{
+		if (isPly(*m_pMappedFile))
+		{
+			m_fBoundingRadius = readPointCloudPly(*m_pMappedFile, m_cFile, m_vPoints, m_vNormals, m_vMinBound, m_vMaxBound);
+		}
+		else
+		{
+			m_fBoundingRadius = readPointCloud(m_cFile, m_vPoints, m_vMinBound, m_vMaxBound);
+		}
+		delete m_pMappedFile;
+		m_pMappedFile = NULL;
+		m_iVertices = (int)m_vPoints->size();
+		m_pPointData = m_vPoints->data();
+		m_pNormalData = m_vNormals->empty() ? NULL : m_vNormals->data();
+	}
 }
 
 void PointCloud::OutputPoints()
 {
 	for(int i = 0; i < m_iVertices; i++)
 	{
-		showVec3("", (*m_vPoints)[i]);
+		showVec3("", m_pPointData[i]);
 	}
 }
@@ -21,32 +21,43 @@ class PointCloud
 private:
     char* m_cFile; // Model file name
     int m_iVertices; // Number of vertices
-    GLuint* m_gliVAO;
-    GLuint* m_gliBuffer;
-    GLuint* m_gliShaderProgram;
+    unsigned int* m_gliVAO; // GL names for drawing, NULL for headless point clouds
+    unsigned int* m_gliBuffer;
+    unsigned int* m_gliShaderProgram;
     float m_fBoundingRadius; // Bounding radius of model
-	std::vector<glm::vec3>* m_vPoints; // Points in the point cloud
+	std::vector<glm::vec3>* m_vPoints; // Points in the point cloud (text and ply files)
+	std::vector<glm::vec3>* m_vNormals; // Normals in the point cloud (ply files)
+	MappedFile* m_pMappedFile; // Mapped *.pcb file, NULL for other files
+	const glm::vec3* m_pPointData; // Points, either m_vPoints or the mapped file
+	const glm::vec3* m_pNormalData; // Normals, either m_vNormals or the mapped file, NULL if none
 	glm::vec3 m_vMinBound; // Minimum bound coordinate
 	glm::vec3 m_vMaxBound; // Maximum bound coordinate
 
-    // Initialize and load model
+    // Load positions and bounds
     void Init();
 
 public:
-	PointCloud(char* modelFile, GLuint* VAO, GLuint* buffer, GLuint* shaderProgram);
+	// Only positions and bounds are loaded, no GL context is needed.  The VAO, buffer and shader program
+	// (GLuint names) are kept for drawing; the viewer uploads the points with bufferPointCloud(...).
+	PointCloud(char* modelFile, unsigned int* VAO = NULL, unsigned int* buffer = NULL, unsigned int* shaderProgram = NULL);
 
     ~PointCloud()
     {
         delete []m_cFile;
+        delete m_vPoints;
+        delete m_vNormals;
+        delete m_pMappedFile;
     }
 
     char* File() const { return m_cFile; }
     int Vertices() const { return m_iVertices; }
-    GLuint* VAO() const { return m_gliVAO; }
-    GLuint* Buffer() const { return m_gliBuffer; }
-    GLuint* ShaderProgram() const { return m_gliShaderProgram; }
+    unsigned int* VAO() const { return m_gliVAO; }
+    unsigned int* Buffer() const { return m_gliBuffer; }
+    unsigned int* ShaderProgram() const { return m_gliShaderProgram; }
     float BoundingRadius() const { return m_fBoundingRadius; }
-	std::vector<glm::vec3>* Points() const { return m_vPoints; }
+	std::vector<glm::vec3>* Points() const { return m_vPoints; } // Empty for *.pcb files
+	const glm::vec3* PointData() const { return m_pPointData; } // Valid while the point cloud lives
+	const glm::vec3* NormalData() const { return m_pNormalData; } // Oriented normals from the file, NULL if none
 	glm::vec3 MinBound() const { return m_vMinBound; }
 	glm::vec3 MaxBound() const { return m_vMaxBound; }
 	void OutputPoints();
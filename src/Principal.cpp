@@ -18,7 +18,12 @@ namespace HuguesHoppe
 		std::swap(range1[2], range2[2]);
 	}
 
-	void principal_components(std::vector<glm::vec3> pa, glm::mat4x3& f, glm::vec3& eimag)
+	// Index in a packed covariance (xx, xy, xz, yy, yz, zz) of each matrix element
+	static const int k_cov_index[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+
+	static void principal_frame_jacobi(const float cov[6], const glm::vec3& avgp, glm::mat4x3& f, glm::vec3& eimag);
+
+	void principal_components(const std::vector<glm::vec3>& pa, glm::mat4x3& f, glm::vec3& eimag)
 	{
 		assert(pa.size() > 0);
 		glm::vec3 hp = glm::vec3(); for_int(i, pa.size()) { hp += pa[i]; }
@@ -26,17 +31,29 @@ namespace HuguesHoppe
 		principal_components2(pa, avgp, f, eimag);
 	}
 
-	void principal_components2(std::vector<glm::vec3> va, const glm::vec3& avgp, glm::mat4x3& f, glm::vec3& eimag)
+	void principal_components2(const std::vector<glm::vec3>& va, const glm::vec3& avgp, glm::mat4x3& f, glm::vec3& eimag)
 	{
-		// Note that this builds on version of compute_eigenvectors() specialized to n = 3.
-		const int n = 3;
-		glm::mat3 a;
-		for_int(c0, n) {
+		float cov[6];
+		covariance(va, avgp, cov);
+		principal_frame_jacobi(cov, avgp, f, eimag);
+	}
+
+	void covariance(const std::vector<glm::vec3>& va, const glm::vec3& avgp, float cov[6])
+	{
+		for_int(c0, 3) {
 			for_int(c1, c0 + 1) {
 				double sum = 0.; for_int(i, va.size()) { sum += (va[i][c0] - avgp[c0])*(va[i][c1] - avgp[c1]); }
-				a[c0][c1] = a[c1][c0] = float(sum / va.size());
+				cov[k_cov_index[c0][c1]] = float(sum / va.size());
 			}
 		}
+	}
+
+	static void principal_frame_jacobi(const float cov[6], const glm::vec3& avgp, glm::mat4x3& f, glm::vec3& eimag)
+	{
+		// Note that this builds on version of compute_eigenvectors() specialized to n = 3.
+		const int n = 3;
+		glm::mat3 a;
+		for_int(c0, n) for_int(c1, n) { a[c0][c1] = cov[k_cov_index[c0][c1]]; }
 		glm::vec3 val; for_int(i, n) { val[i] = a[i][i]; }
 		glm::mat3 vec = { { 1.f, 0.f, 0.f },{ 0.f, 1.f, 0.f },{ 0.f, 0.f, 1.f } };
 		for_int(iter, INT_MAX) {
@@ -103,6 +120,159 @@ namespace HuguesHoppe
 		make_right_handed(f);
 	}
 
+	// *** Closed-form eigensystems
+
+	// acos(x) to about 2e-8 (Abramowitz and Stegun 4.4.46), without branches.
+	inline float acos_poly(float x)
+	{
+		float ax = std::min(std::abs(x), 1.f);
+		float p = -0.0012624911f;
+		p = p * ax + 0.0066700901f;
+		p = p * ax - 0.0170881256f;
+		p = p * ax + 0.0308918810f;
+		p = p * ax - 0.0501743046f;
+		p = p * ax + 0.0889789874f;
+		p = p * ax - 0.2145988016f;
+		p = p * ax + 1.5707963050f;
+		float r = std::sqrt(1.f - ax) * p;
+		return x < 0.f ? 3.14159265f - r : r;
+	}
+
+	// cos(x) and sin(x) for x in [0, pi/3], by their Taylor series to about 1e-8.
+	inline void cos_sin_poly(float x, float& c, float& s)
+	{
+		float x2 = x * x;
+		c = 1.f + x2 * (-1.f / 2 + x2 * (1.f / 24 + x2 * (-1.f / 720 + x2 * (1.f / 40320 + x2 * (-1.f / 3628800)))));
+		s = x * (1.f + x2 * (-1.f / 6 + x2 * (1.f / 120 + x2 * (-1.f / 5040 + x2 * (1.f / 362880 + x2 * (-1.f / 39916800))))));
+	}
+
+	// Unnormalized eigenvector of the symmetric matrix a for its eigenvalue l:  the largest cross product of two rows
+	// of a - l I, with its squared length in len2.
+	inline void null_vector(const float a[6], float l, float v[3], float& len2)
+	{
+		float r0[3] = { a[0] - l, a[1], a[2] }, r1[3] = { a[1], a[3] - l, a[4] }, r2[3] = { a[2], a[4], a[5] - l };
+		float c01[3] = { r0[1] * r1[2] - r0[2] * r1[1], r0[2] * r1[0] - r0[0] * r1[2], r0[0] * r1[1] - r0[1] * r1[0] };
+		float c02[3] = { r0[1] * r2[2] - r0[2] * r2[1], r0[2] * r2[0] - r0[0] * r2[2], r0[0] * r2[1] - r0[1] * r2[0] };
+		float c12[3] = { r1[1] * r2[2] - r1[2] * r2[1], r1[2] * r2[0] - r1[0] * r2[2], r1[0] * r2[1] - r1[1] * r2[0] };
+		float d01 = c01[0] * c01[0] + c01[1] * c01[1] + c01[2] * c01[2];
+		float d02 = c02[0] * c02[0] + c02[1] * c02[1] + c02[2] * c02[2];
+		float d12 = c12[0] * c12[0] + c12[1] * c12[1] + c12[2] * c12[2];
+		bool use02 = d02 > d01, use12 = d12 > (use02 ? d02 : d01);
+		for_int(c, 3) { v[c] = use12 ? c12[c] : use02 ? c02[c] : c01[c]; }
+		len2 = use12 ? d12 : use02 ? d02 : d01;
+	}
+
+	// The eigensystems of a lane of covariances, stored component-major so that the loop over lanes vectorizes.
+	struct EigenLanes
+	{
+		static constexpr int k_lanes = 64;
+		float a[6][k_lanes];             // covariance scaled by 1 / scale
+		float scale[k_lanes];
+		float val[3][k_lanes];           // eigenvalues, descending, times scale
+		float vec[3][3][k_lanes];        // unit eigenvectors, a right-handed frame
+		int fallback[k_lanes];           // the normal (last eigenvector) is ill-conditioned
+	};
+
+	inline float clampf(float x, float lo, float hi) { return x < lo ? lo : x > hi ? hi : x; }
+
+	// Eigenvalues from the trigonometric solution of the characteristic cubic, eigenvectors from cross products.
+	// The loop over lanes vectorizes only if std::sqrt need not set errno and the selects may ignore floating point
+	// exceptions (-fno-math-errno -fno-trapping-math, which the Makefile passes for this file; neither changes a result).
+	// Eigenvalues closer than k_gap times their spread are treated as repeated:  a repeated smallest one leaves the
+	// normal undefined (left to the Jacobi iterations), while a repeated largest one lets the first axis be any
+	// direction orthogonal to the normal.
+	static void solve_lanes(EigenLanes& e, int n)
+	{
+		const float k_gap = 1e-3f, k_sqrt3 = 1.7320508f, k_tiny = 1e-30f;
+		for_int(l, n)
+		{
+			const float a[6] = { e.a[0][l], e.a[1][l], e.a[2][l], e.a[3][l], e.a[4][l], e.a[5][l] };
+			float q = (a[0] + a[3] + a[5]) * (1.f / 3);
+			float b0 = a[0] - q, b3 = a[3] - q, b5 = a[5] - q;
+			float p2 = (b0 * b0 + b3 * b3 + b5 * b5 + 2.f * (a[1] * a[1] + a[2] * a[2] + a[4] * a[4])) * (1.f / 6);
+			float p = std::sqrt(p2);
+			float det = b0 * (b3 * b5 - a[4] * a[4]) - a[1] * (a[1] * b5 - a[4] * a[2]) + a[2] * (a[1] * a[4] - b3 * a[2]);
+			float pinv = 1.f / (p > k_tiny ? p : k_tiny);
+			float r = clampf(0.5f * det * pinv * pinv * pinv, -1.f, 1.f);
+			float c, s; cos_sin_poly(acos_poly(r) * (1.f / 3), c, s);
+			float l0 = q + 2.f * p * c, l1 = q - p * (c - k_sqrt3 * s), l2 = q - p * (c + k_sqrt3 * s);
+			float spread = l0 - l2;
+			e.val[0][l] = l0 * e.scale[l]; e.val[1][l] = l1 * e.scale[l]; e.val[2][l] = l2 * e.scale[l];
+			e.fallback[l] = !(spread > 0.f) | (l1 - l2 < k_gap * spread);
+			// Normal, refined once with the Rayleigh quotient of the first estimate, which is much more accurate than l2
+			float v2[3], len2; null_vector(a, l2, v2, len2);
+			float inv2 = 1.f / std::sqrt(len2 > k_tiny ? len2 : k_tiny);
+			for_int(k, 3) { v2[k] *= inv2; }
+			float av2[3] = { a[0] * v2[0] + a[1] * v2[1] + a[2] * v2[2], a[1] * v2[0] + a[3] * v2[1] + a[4] * v2[2],
+				a[2] * v2[0] + a[4] * v2[1] + a[5] * v2[2] };
+			l2 = av2[0] * v2[0] + av2[1] * v2[1] + av2[2] * v2[2];
+			null_vector(a, l2, v2, len2);
+			inv2 = 1.f / std::sqrt(len2 > k_tiny ? len2 : k_tiny);
+			for_int(k, 3) { v2[k] *= inv2; }
+			// First axis, orthogonal to the normal
+			float v0[3], len0; null_vector(a, l0, v0, len0);
+			{
+				// if repeated, any direction:  the normal crossed with the coordinate axis least aligned with it
+				float ax = std::abs(v2[0]), ay = std::abs(v2[1]), az = std::abs(v2[2]);
+				bool xaxis = (ax <= ay) & (ax <= az), yaxis = !xaxis & (ay <= az);
+				float ux = xaxis ? 1.f : 0.f, uy = yaxis ? 1.f : 0.f, u[3] = { ux, uy, 1.f - ux - uy };
+				float w[3] = { v2[1] * u[2] - v2[2] * u[1], v2[2] * u[0] - v2[0] * u[2], v2[0] * u[1] - v2[1] * u[0] };
+				bool repeated = l0 - l1 < k_gap * spread;
+				for_int(k, 3) { v0[k] = repeated ? w[k] : v0[k]; }
+			}
+			float d = v0[0] * v2[0] + v0[1] * v2[1] + v0[2] * v2[2];
+			for_int(k, 3) { v0[k] -= d * v2[k]; }
+			len0 = v0[0] * v0[0] + v0[1] * v0[1] + v0[2] * v0[2];
+			float inv0 = 1.f / std::sqrt(len0 > k_tiny ? len0 : k_tiny);
+			for_int(k, 3) { v0[k] *= inv0; }
+			float v1[3] = { v2[1] * v0[2] - v2[2] * v0[1], v2[2] * v0[0] - v2[0] * v0[2], v2[0] * v0[1] - v2[1] * v0[0] };
+			for_int(k, 3) { e.vec[0][k][l] = v0[k]; e.vec[1][k][l] = v1[k]; e.vec[2][k][l] = v2[k]; }
+		}
+	}
+
+	void principal_frames(int n, const float* cov, const glm::vec3* avgp, glm::mat4x3* f, glm::vec3* eimag)
+	{
+		const int lanes = EigenLanes::k_lanes;
+		EigenLanes e;
+		for (int b = 0; b < n; b += lanes)
+		{
+			int nl = std::min(lanes, n - b);
+			// Scaled to unit largest element, so the cubic neither underflows nor overflows
+			for_int(l, nl)
+			{
+				const float* c = cov + size_t(b + l) * 6;
+				float m = 0.f; for_int(k, 6) { m = std::max(m, std::abs(c[k])); }
+				e.scale[l] = m > 0.f ? m : 1.f;
+				float inv = 1.f / e.scale[l];
+				for_int(k, 6) { e.a[k][l] = c[k] * inv; }
+			}
+			solve_lanes(e, nl);
+			for_int(l, nl)
+			{
+				int i = b + l;
+				glm::vec3 ev;
+				if (e.fallback[l])
+				{
+					principal_frame_jacobi(cov + size_t(i) * 6, avgp[i], f[i], ev);
+				}
+				else
+				{
+					for_int(k, 3) {
+						float v = e.val[k][l];
+						if (v<0.f) v = 0.f;     // for numerics
+						v = sqrt(v);
+						ev[k] = v;
+						if (!v) v = 1e-15f;     // very small but non-zero vector
+						f[i][k] = v*glm::vec3(e.vec[k][0][l], e.vec[k][1][l], e.vec[k][2][l]);
+					}
+					f[i][3] = avgp[i];
+					make_right_handed(f[i]);
+				}
+				if (eimag) eimag[i] = ev;
+			}
+		}
+	}
+
 	void make_right_handed(glm::mat4x3& f)
 	{
 		if (glm::dot( glm::cross(f[0], f[1]), f[2] ) < 0)
@@ -11,10 +11,51 @@ namespace HuguesHoppe
 	//   will always have non-zero (albeit very small) lengths.
 	// The values eimag will be zero for the axes that should be zero.
 	// The frame f is also guaranteed to be right-handed.
-	void principal_components(std::vector<glm::vec3> pa, glm::mat4x3& f, glm::vec3& eimag);
-	void principal_components2(std::vector<glm::vec3> va, const glm::vec3& avgp, glm::mat4x3& f, glm::vec3& eimag);
+	void principal_components(const std::vector<glm::vec3>& pa, glm::mat4x3& f, glm::vec3& eimag);
+	void principal_components2(const std::vector<glm::vec3>& va, const glm::vec3& avgp, glm::mat4x3& f, glm::vec3& eimag);
+	// Covariance of the points va[] about avgp, packed as the upper triangle xx, xy, xz, yy, yz, zz.
+	void covariance(const std::vector<glm::vec3>& va, const glm::vec3& avgp, float cov[6]);
+	// Same frames and eigenvalues for n point sets at once, given their covariances cov[6*i...] and centers avgp[i].
+	// The eigensystems are solved in closed form over lanes of many matrices, which vectorize; the few whose normal
+	// is ill-conditioned (nearly repeated smallest eigenvalue) are solved iteratively as above. eimag may be null.
+	void principal_frames(int n, const float* cov, const glm::vec3* avgp, glm::mat4x3* f, glm::vec3* eimag = nullptr);
 	void make_right_handed(glm::mat4x3& f);
 
+	// Moments of a point set (count, sum, and sum of outer products) accumulated one point at a time, from which its
+	// centroid and covariance follow without storing the points.  They are taken about the first point entered, so
+	// that the covariance keeps its precision far from the origin.
+	class Moments
+	{
+	public:
+		void clear() { _n = 0; _origin = glm::vec3(0.f); for_int(c, 3) { _s[c] = 0.; } for_int(c, 6) { _s2[c] = 0.; } }
+		void enter(const glm::vec3& p)
+		{
+			if (!_n) _origin = p; // the sums are still zero
+			double d0 = double(p[0]) - _origin[0], d1 = double(p[1]) - _origin[1], d2 = double(p[2]) - _origin[2];
+			_n++;
+			_s[0] += d0; _s[1] += d1; _s[2] += d2;
+			_s2[0] += d0 * d0; _s2[1] += d0 * d1; _s2[2] += d0 * d2; _s2[3] += d1 * d1; _s2[4] += d1 * d2; _s2[5] += d2 * d2;
+		}
+		int count() const { return _n; }
+		glm::vec3 mean() const
+		{
+			assert(_n > 0);
+			return _origin + glm::vec3(float(_s[0] / _n), float(_s[1] / _n), float(_s[2] / _n));
+		}
+		// Covariance about the mean, packed as in covariance() above.
+		void covariance(float cov[6]) const
+		{
+			assert(_n > 0);
+			double m[3] = { _s[0] / _n, _s[1] / _n, _s[2] / _n };
+			static const int c0[6] = { 0, 0, 0, 1, 1, 2 }, c1[6] = { 0, 1, 2, 1, 2, 2 };
+			for_int(k, 6) { cov[k] = float(_s2[k] / _n - m[c0[k]] * m[c1[k]]); }
+		}
+	private:
+		int _n = 0;
+		glm::vec3 _origin{};
+		double _s[3] = {}, _s2[6] = {}; // about _origin
+	};
+
 } // namespace hh
 
 #endif // PRINCIPAL_H
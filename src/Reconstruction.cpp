@@ -0,0 +1,527 @@
+#include "Reconstruction.hpp"
+#include "Principal.hpp"
+#include "Contour.hpp"
+using namespace HuguesHoppe;
+
+int numVertices; // number of points
+const glm::vec3* points; // The point cloud points, owned by the caller
+Vec2<glm::vec3> pcBoxBound;
+int minkintp = 4, maxkintp = 20, gridsize = 10; // Min/Max number of points in tangent plane
+float samplingDensity = 0.0f; // Sampling density
+SpatialIndex spatialIndex = SPATIAL_GRID;
+bool mortonOrder = false;
+float searchEpsilon = 0.f;
+const char* tangentPlaneCacheDir = NULL;
+std::vector<int> pointOrder; // caller's index of each point when reordered
+std::vector<glm::vec3> orderedPoints; // points in Morton order, when reordered
+std::vector<glm::vec3> pcTPOrig; // Origins of Tangent Planes
+std::vector<glm::mat4x3> pcTP; // Tangent planes
+std::vector<glm::vec3> pcTPNorm; // Normals of Tangen Planes
+std::vector<bool> pcTPOrient; // Is tangent plane oriented
+std::unique_ptr<Spatial> SPp; // Point spatial partition
+std::unique_ptr<Spatial> SPpc; // pcTPOrig spatial partition
+std::unique_ptr<Graph<int>> gpcpseudo; // Riemannian on pc centers (based on co)
+std::unique_ptr<Graph<int>> gpcpath; // path of orientation propagation
+Mesh mesh;
+size_t contour_bytes = 0; // contour grid nodes of the last contour, freed with it
+TangentPlaneCacheKey cacheKey; // key of the tangent planes, with tangentPlaneCacheDir
+
+// Cells per axis of the spatial partitions
+static int spatial_size()
+{
+	return numVertices > 100000 ? 60 : numVertices > 5000 ? 36 : 20;
+}
+
+SpatialIndex spatialIndexFromName(const std::string& name)
+{
+	if (name == "grid") return SPATIAL_GRID;
+	if (name == "kdtree") return SPATIAL_KDTREE;
+	return SPATIAL_INVALID;
+}
+
+const char* spatialIndexName(SpatialIndex index)
+{
+	return index == SPATIAL_GRID ? "grid" : index == SPATIAL_KDTREE ? "kdtree" : "invalid";
+}
+
+// Sort the caller's points p[] along a Morton curve over the bounds into orderedPoints, pointOrder
+static void morton_order_points(int n, const glm::vec3* p)
+{
+	ScopedTimer timer("morton_order");
+	glm::vec3 scale;
+	for_int(c, 3)
+	{
+		float size = pcBoxBound[1][c] - pcBoxBound[0][c];
+		scale[c] = size > 0.f ? float((1 << mortonBits) - 1) / size : 0.f;
+	}
+	std::vector<std::pair<uint64_t, int>> keys(n);
+	parallelFor((n + 0xffff) >> 16, [&](int block)
+	{
+		for (int i = block << 16, e = std::min(n, i + 0x10000); i < e; i++)
+		{
+			uint32_t ci[3];
+			for_int(c, 3) { ci[c] = uint32_t(clamp((p[i][c] - pcBoxBound[0][c]) * scale[c], 0.f, float((1 << mortonBits) - 1))); }
+			keys[i] = std::make_pair(mortonEncode(ci[0], ci[1], ci[2]), i);
+		}
+	});
+	parallelSort(keys, [](const std::pair<uint64_t, int>& a, const std::pair<uint64_t, int>& b) { return a < b; });
+	pointOrder.resize(n);
+	orderedPoints.resize(n);
+	parallelFor((n + 0xffff) >> 16, [&](int block)
+	{
+		for (int i = block << 16, e = std::min(n, i + 0x10000); i < e; i++)
+		{
+			pointOrder[i] = keys[i].second;
+			orderedPoints[i] = p[keys[i].second];
+		}
+	});
+}
+
+// Spatial partition of the n points p[] of the kind selected by spatialIndex, searched with searchEpsilon
+static std::unique_ptr<Spatial> make_point_spatial(int n, const glm::vec3* p)
+{
+	std::unique_ptr<Spatial> sp;
+	if (spatialIndex == SPATIAL_KDTREE) sp = std::make_unique<KdPointSpatial>(pcBoxBound, n, p);
+	else sp = std::make_unique<GridPointSpatial>(spatial_size(), pcBoxBound, n, p);
+	sp->set_epsilon(searchEpsilon);
+	return sp;
+}
+
+// Compute the centroid avgp and covariance cov[6] of the maxkintp nearest points nbrs[] of a point, with squared
+// distances nbrdis2[], from which its tangent plane follows; n is the number of them used, the first n of nbrs[].
+// Their moments are accumulated as the neighbors are scanned, without gathering the points.
+void tp_covariance(const int* nbrs, const float* nbrdis2, int& n, glm::vec3& avgp, float* cov)
+{
+	Moments moments;
+	for_int(j, maxkintp) {
+		int pointId = nbrs[j];
+		if (pointId < 0 || (j <= minkintp && nbrdis2[j] > square(samplingDensity))) break;
+		moments.enter(points[pointId]);
+	}
+	avgp = moments.mean();
+	moments.covariance(cov);
+	n = moments.count();
+}
+
+// Enter into gpcpseudo the undirected edges from each point i to its neighbors nbrids[nbrstart[i], nbrstart[i+1]),
+// with the edge lists in the order they would get from entering these edges one by one in point order, skipping the
+// ones already present. The edges of every point are gathered in parallel from its neighbors and the points having
+// it as neighbor: an edge is entered by the first of its two points to have the other as neighbor.
+static void enter_neighbor_graph(const std::vector<size_t>& nbrstart, const std::vector<int>& nbrids)
+{
+	int n = numVertices;
+	// Points having each point as neighbor, in increasing order
+	std::vector<size_t> revstart(n + 1, 0);
+	for_int(i, n) for (size_t k = nbrstart[i]; k < nbrstart[i + 1]; k++) { if (nbrids[k] != i) revstart[nbrids[k] + 1]++; }
+	for_int(i, n) { revstart[i + 1] += revstart[i]; }
+	std::vector<int> revids(revstart[n]);
+	{
+		std::vector<size_t> offset(revstart.begin(), revstart.end() - 1);
+		for_int(i, n) for (size_t k = nbrstart[i]; k < nbrstart[i + 1]; k++) { if (nbrids[k] != i) revids[offset[nbrids[k]]++] = i; }
+	}
+	const int chunkSize = 1024;
+	parallelFor((n + chunkSize - 1) / chunkSize, [&](int chunk)
+	{
+		for (int v = chunk * chunkSize, e = std::min(n, v + chunkSize); v < e; v++)
+		{
+			const int* rb = revids.data() + revstart[v], * re = revids.data() + revstart[v + 1];
+			const int* rmid = std::lower_bound(rb, re, v);
+			const int* nb = nbrids.data() + nbrstart[v], * ne = nbrids.data() + nbrstart[v + 1];
+			std::vector<int> edges;
+			edges.reserve((rmid - rb) + (ne - nb) + (re - rmid));
+			edges.insert(edges.end(), rb, rmid); // entered by earlier points
+			for (const int* p = nb; p < ne; p++) { if (*p != v && !std::binary_search(rb, rmid, *p)) edges.push_back(*p); }
+			for (const int* p = rmid; p < re; p++) { if (std::find(nb, ne, *p) == ne) edges.push_back(*p); } // by later points
+			gpcpseudo->assign_edges(v, std::move(edges));
+		}
+	});
+}
+
+void process_principal()
+{
+	// Neighbors are queried in blocks of points to bound the size of the neighbor arrays.
+	// The tangent planes of a block are computed in parallel, each point keeping the number of its neighbors used;
+	// these neighbors are collected for all the points and then entered into gpcpseudo.
+	// Each chunk gathers the covariances of its points and solves their eigensystems in one batch.
+	const int blockSize = 1 << 16, chunkSize = 256;
+	std::vector<int> nbrs;
+	std::vector<float> nbrdis2;
+	std::vector<int> nused;
+	std::vector<glm::vec3> avgp;
+	std::vector<float> cov;
+	std::vector<size_t> usedstart(1, 0); // neighbors used by point i:  usedids[usedstart[i], usedstart[i+1])
+	std::vector<int> usedids;
+	usedstart.reserve(numVertices + 1);
+	for (int b = 0; b < numVertices; b += blockSize)
+	{
+		int nb = std::min(blockSize, numVertices - b);
+		nbrs.resize(size_t(nb) * maxkintp);
+		nbrdis2.resize(size_t(nb) * maxkintp);
+		nused.resize(nb);
+		avgp.resize(nb);
+		cov.resize(size_t(nb) * 6);
+		{
+			ScopedTimer timer("knn");
+			SPp->knn(nb, points + b, maxkintp, nbrs.data(), nbrdis2.data());
+		}
+		{
+			ScopedTimer timer("principal");
+			parallelFor((nb + chunkSize - 1) / chunkSize, [&](int chunk)
+			{
+				int j0 = chunk * chunkSize, e = std::min(nb, j0 + chunkSize);
+				for_intL(j, j0, e) {
+					tp_covariance(&nbrs[size_t(j) * maxkintp], &nbrdis2[size_t(j) * maxkintp], nused[j], avgp[j], &cov[size_t(j) * 6]);
+				}
+				principal_frames(e - j0, &cov[size_t(j0) * 6], &avgp[j0], &pcTP[b + j0]);
+				for_intL(i, b + j0, b + e) {
+					pcTPOrig[i] = pcTP[i][3];
+					pcTPNorm[i] = glm::normalize(pcTP[i][2]);
+				}
+			});
+		}
+		for_int(j, nb)
+		{
+			const int* row = &nbrs[size_t(j) * maxkintp];
+			usedids.insert(usedids.end(), row, row + nused[j]);
+			usedstart.push_back(usedids.size());
+		}
+	}
+	ScopedTimer timer("graph");
+	enter_neighbor_graph(usedstart, usedids);
+}
+
+// Set tangent plane i to the oriented plane through origin along the unit normal
+static void set_oriented_plane(int i, const glm::vec3& origin, const glm::vec3& normal)
+{
+	glm::vec3 tangent = std::abs(normal.x) > std::abs(normal.z) ?
+		glm::vec3(-normal.y, normal.x, 0.f) : glm::vec3(0.f, -normal.z, normal.y);
+	glm::mat4x3 f;
+	f[0] = glm::normalize(tangent);
+	f[1] = glm::cross(normal, f[0]);
+	f[2] = normal;
+	f[3] = origin;
+	pcTP[i] = f;
+	pcTPOrig[i] = origin;
+	pcTPNorm[i] = normal;
+	pcTPOrient[i] = true;
+}
+
+// Use oriented normals from the point cloud file (in the caller's order) as tangent planes through the points
+void tangent_planes_from_normals(const glm::vec3* normals)
+{
+	for_int(i, numVertices)
+	{
+		const glm::vec3& fileNormal = normals[pointOrder.empty() ? i : pointOrder[i]];
+		glm::vec3 normal = glm::length2(fileNormal) > 0.f ? glm::normalize(fileNormal) : glm::vec3(0.f, 0.f, 1.f);
+		set_oriented_plane(i, points[i], normal);
+	}
+}
+
+// Key of the tangent planes of the points with the current settings
+static TangentPlaneCacheKey tangent_plane_cache_key()
+{
+	TangentPlaneCacheKey key;
+	memset(&key, 0, sizeof(key));
+	key.pointsHash = contentHash(points, size_t(numVertices) * sizeof(glm::vec3));
+	key.count = numVertices;
+	key.minkintp = minkintp;
+	key.maxkintp = maxkintp;
+	key.samplingDensity = samplingDensity;
+	key.searchEpsilon = searchEpsilon;
+	key.spatialIndex = spatialIndex;
+	key.mortonOrder = mortonOrder;
+	return key;
+}
+
+// Load the oriented tangent planes of cacheKey from tangentPlaneCacheDir, false if they are not there
+static bool load_tangent_plane_cache()
+{
+	ScopedTimer timer("cache_load");
+	MappedFile file(tangentPlaneCachePath(tangentPlaneCacheDir, cacheKey).c_str());
+	const TangentPlaneCacheHeader* header = readTangentPlaneCache(file, cacheKey);
+	addStat(header != NULL ? "tangent_plane_cache_hits" : "tangent_plane_cache_misses", 1);
+	if (header == NULL) return false;
+	const glm::vec3* origins = tangentPlaneCacheOrigins(header);
+	const glm::vec3* normals = tangentPlaneCacheNormals(header);
+	for_int(i, numVertices) { set_oriented_plane(i, origins[i], normals[i]); }
+	return true;
+}
+
+float pc_corr(int i, int j)
+{
+	if (j == numVertices && i < numVertices) return pc_corr(j, i);
+	assert(i >= 0 && j >= 0 && i <= numVertices && j < numVertices);
+	float vdot, corr;
+
+	if (i == numVertices)
+	{
+		vdot = 1.f;     // single exterior link
+	}
+	else
+	{
+		vdot = glm::dot(pcTPNorm[i], pcTPNorm[j]);
+	}
+	corr = 2.f - std::abs(vdot);
+
+	return corr;
+}
+
+// Compute the dot product between two tangent planes
+float pc_dot(int i, int j)
+{
+	assert(i >= 0 && j >= 0 && i <= numVertices && j < numVertices);
+	if (i == numVertices)
+	{
+		return pcTPNorm[j][2] < 0.f ? -1.f : 1.f;
+	}
+	else
+	{
+		return glm::dot(pcTPNorm[i], pcTPNorm[j]);
+	}
+}
+
+// Propagate orientation along tree gpcpath from vertex i (orig. num) using recursive DFS.
+void propagate_along_path(int i)
+{
+	assert(i >= 0 && i <= numVertices);
+	if (i < numVertices) assert(pcTPOrient[i]);
+	for (int j : gpcpath->edges(i))
+	{
+		assert(j >= 0 && j <= numVertices);
+		if (j == numVertices || pcTPOrient[j]) continue; // immediate caller
+		float corr = pc_dot(i, j);
+		if (corr<0) pcTPNorm[j] = -pcTPNorm[j];
+		pcTPOrient[j] = true;
+		propagate_along_path(j);
+	}
+}
+
+void add_exterior_orientation(const std::set<int>& nodes)
+{
+	// vertex num is a pseudo-node used for outside orientation
+	gpcpseudo->enter(numVertices);
+
+	// add 1 pseudo-edge to point with largest z value
+	float maxz = -BIGFLOAT;
+	int maxi = -1;
+
+	for (int i : nodes)
+	{
+		if (pcTPOrig[i][2] > maxz) { maxz = pcTPOrig[i][2]; maxi = i; }
+	}
+
+	gpcpseudo->enter_undirected(maxi, numVertices);
+}
+
+void remove_exterior_orientation()
+{
+	std::vector<int> ari = std::vector<int>();
+	for (int j : gpcpseudo->edges(numVertices)) { ari.push_back(j); }
+	for (int i : ari) { gpcpseudo->remove_undirected(numVertices, i); }
+	gpcpseudo->remove(numVertices);
+}
+
+// Orient the set of tangent planes (orient surface normals)
+void orient_set(const std::set<int>& nodes)
+{
+	addStat("orient_components", 1);
+	add_exterior_orientation(nodes);
+	gpcpath = std::make_unique<Graph<int>>();
+	for (int i : nodes) { gpcpath->enter(i); }
+	gpcpath->enter(numVertices);
+	{
+		// must be connected here!
+		ScopedTimer timer("mst");
+		assert(graph_mst<int>(*gpcpseudo, pc_corr, *gpcpath));
+	}
+	addStat("orient_exterior_links", gpcpath->out_degree(numVertices));
+	propagate_along_path(numVertices);
+	gpcpath.reset();
+	remove_exterior_orientation();
+}
+
+// Orient each tangent plane, by considering neighbors
+void orient_tp()
+{
+	// Now treat each connected component of gpcpseudo separately.
+	std::set<int> setnotvis = std::set<int>();
+	for_int(i, numVertices) { setnotvis.insert(i); }
+
+	while (!setnotvis.empty())
+	{
+		std::set<int> nodes = std::set<int>();
+		std::queue<int> queue = std::queue<int>();
+		int fi = *(setnotvis.begin());
+		nodes.insert(fi);
+		queue.push(fi);
+
+		while (!queue.empty())
+		{
+			int i = queue.front();
+			queue.pop();
+			assert(setnotvis.erase(i));
+
+			for (int j : gpcpseudo->edges(i))
+			{
+				if (nodes.insert(j).second) queue.push(j);
+			}
+		}
+
+		orient_set(nodes);
+	}
+
+	for_int(i, numVertices) { assert(pcTPOrient[i]); }
+}
+
+// Find the closest tangent plane origin and compute the signed distance to that tangent plane.
+// Was: check to see if the projection onto the tangent plane lies farther than samplingDensity from any data point.
+// Now: check to see if the sample point is farther than samplingDensity+cube_size from any data point.
+float compute_signed(const glm::vec3& p, glm::vec3& proj)
+{
+	int tpi = SPpc->nearest(p);
+	glm::vec3 vptopc = p - pcTPOrig[tpi];
+	float dis = glm::dot(vptopc, pcTPNorm[tpi]);
+	proj = p - dis * pcTPNorm[tpi];
+
+	// Check that projected point is in point cloud space
+	for_int(i, 3)
+	{
+		float min = pcBoxBound[0][i], max = pcBoxBound[1][i];
+		float dis = 0.1f;
+		if (proj[i] < pcBoxBound[0][i] - dis || proj[i] > pcBoxBound[1][i] + dis)
+			return k_Contour_undefined;
+	}
+
+	// check that projected point is close to a data point
+	float dis2;
+	if (SPp->nearest(proj, &dis2) < 0 || dis2 > square(samplingDensity))
+		return k_Contour_undefined;
+
+	// check that grid point is close to a data point
+	float dis3; SPp->nearest(p, &dis3);
+	float xDis = pcBoxBound[1][0] - pcBoxBound[0][0];
+	float yDis = pcBoxBound[1][1] - pcBoxBound[0][1];
+	float zDis = pcBoxBound[1][2] - pcBoxBound[0][2];
+	float grid_diagonal2 = square(xDis / gridsize) + square(yDis / gridsize) + square(zDis / gridsize);
+	const float fudge = 1.2f;
+
+	// This may be required
+	//if (dis3>grid_diagonal2*square(fudge))
+	//	return k_Contour_undefined;
+
+	return dis;
+}
+
+struct eval_point
+{
+	float operator()(const glm::vec3& pp) const
+	{
+		glm::vec3 p = pp;
+		glm::vec3 proj;
+		float dis = compute_signed(p, proj);
+		if (dis == k_Contour_undefined) return dis;
+		return dis;
+	}
+};
+
+template<typename Contour> void contour_3D(Contour& contour)
+{
+	for_int(i, numVertices) {
+		contour.march_from(pcTPOrig[i]);
+	}
+}
+
+void setup_reconstruction(int n, const glm::vec3* p, const Vec2<glm::vec3>& bound)
+{
+	ScopedTimer timer("setup");
+	numVertices = n;
+	points = p;
+	pcBoxBound = bound;
+	samplingDensity = INFINITY;
+	pointOrder.clear();
+	orderedPoints.clear();
+	if (mortonOrder)
+	{
+		morton_order_points(n, p);
+		points = orderedPoints.data();
+	}
+
+	// Initialize tangent plane arrays
+	pcTPOrig = std::vector<glm::vec3>(numVertices);
+	pcTPNorm = std::vector<glm::vec3>(numVertices);
+	pcTPOrient = std::vector<bool>(numVertices, false);
+	pcTP = std::vector<glm::mat4x3>(numVertices);
+
+	// Create spatial partition
+	SPp = make_point_spatial(numVertices, points);
+	SPpc.reset();
+	gpcpseudo.reset();
+}
+
+void compute_tangent_planes(const glm::vec3* normals)
+{
+	ScopedTimer timer("tangent_planes");
+	if (normals != NULL)
+	{
+		tangent_planes_from_normals(normals);
+		return;
+	}
+
+	if (tangentPlaneCacheDir != NULL)
+	{
+		cacheKey = tangent_plane_cache_key();
+		if (load_tangent_plane_cache()) return;
+	}
+
+	gpcpseudo = std::make_unique<Graph<int>>();
+	for_int(i, numVertices) { gpcpseudo->enter(i); } // Add point index to graph
+	process_principal(); // Compute the tangent planes
+}
+
+void orient_tangent_planes()
+{
+	ScopedTimer timer("orientation");
+	if (gpcpseudo)
+	{
+		orient_tp(); // Orient tangent planes
+		gpcpseudo.reset();
+		if (tangentPlaneCacheDir != NULL)
+		{
+			ScopedTimer timer("cache_store");
+			writeTangentPlaneCache(tangentPlaneCacheDir, cacheKey, pcTPOrig.data(), pcTPNorm.data());
+		}
+	}
+}
+
+void contour_tangent_planes()
+{
+	ScopedTimer timer("contour");
+	{
+		ScopedTimer timer("spatial_partition");
+		SPpc = make_point_spatial(numVertices, pcTPOrig.data());
+	}
+
+	mesh.clear();
+	{
+		ScopedTimer timer("march");
+		Contour3DMesh<eval_point> contour(gridsize, pcBoxBound, &mesh);
+		contour_3D(contour);
+		contour_bytes = contour.memory_usage();
+	}
+	addStat("mesh_vertices", mesh.num_vertices());
+	addStat("mesh_faces", mesh.num_faces());
+}
+
+std::vector<std::pair<std::string, size_t>> reconstruction_memory()
+{
+	std::vector<std::pair<std::string, size_t>> structures;
+	structures.emplace_back("points", numVertices * sizeof(glm::vec3));
+	structures.emplace_back("point_order", vectorBytes(pointOrder) + vectorBytes(orderedPoints));
+	structures.emplace_back("tangent_planes", vectorBytes(pcTPOrig) + vectorBytes(pcTP) + vectorBytes(pcTPNorm) + vectorBytes(pcTPOrient));
+	structures.emplace_back("SPp", SPp ? SPp->memory_usage() : 0);
+	structures.emplace_back("SPpc", SPpc ? SPpc->memory_usage() : 0);
+	structures.emplace_back("gpcpseudo", gpcpseudo ? gpcpseudo->memory_usage() : 0);
+	structures.emplace_back("mesh", mesh.memory_usage());
+	structures.emplace_back("contour_nodes", contour_bytes);
+	return structures;
+}
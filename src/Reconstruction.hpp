@@ -0,0 +1,60 @@
+#ifndef RECONSTRUCTION_H
+#define RECONSTRUCTION_H
+
+#include "includes/includes.hpp"
+#include "Spatial.hpp"
+#include "Graph.hpp"
+#include "Mesh.hpp"
+
+// Surface reconstruction from unorganized points, split into the stages that are timed:
+//   setup_reconstruction()   tangent plane arrays and the point spatial partition
+//   compute_tangent_planes() principal components of the k nearest points (or the file normals)
+//   orient_tangent_planes()  propagate a consistent orientation along the Riemannian graph MST
+//   contour_tangent_planes() marching cubes over the signed distance to the tangent planes
+// The state is global so the viewer can draw the intermediate results between stages.
+
+// Input
+extern int numVertices; // number of points
+extern const glm::vec3* points; // The point cloud points, owned by the caller
+extern HuguesHoppe::Vec2<glm::vec3> pcBoxBound; // Bounds of the points
+extern int minkintp, maxkintp, gridsize; // Min/Max number of points in tangent plane, contour grid size
+extern float samplingDensity; // Sampling density
+
+// Spatial partition used for the nearest point queries
+enum SpatialIndex { SPATIAL_INVALID, SPATIAL_GRID, SPATIAL_KDTREE };
+extern SpatialIndex spatialIndex;
+SpatialIndex spatialIndexFromName(const std::string& name); // "grid" or "kdtree", else SPATIAL_INVALID
+const char* spatialIndexName(SpatialIndex index);
+extern bool mortonOrder; // reorder the points along a Morton curve in setup_reconstruction()
+extern float searchEpsilon; // approximate nearest searches, up to (1 + searchEpsilon) times farther; 0 is exact
+extern const char* tangentPlaneCacheDir; // directory of cached oriented tangent planes, NULL for none
+
+// Results
+extern std::vector<int> pointOrder; // with mortonOrder, the caller's index of each point, else empty
+extern std::vector<glm::vec3> pcTPOrig; // Origins of Tangent Planes
+extern std::vector<glm::mat4x3> pcTP; // Tangent planes
+extern std::vector<glm::vec3> pcTPNorm; // Normals of Tangen Planes
+extern std::vector<bool> pcTPOrient; // Is tangent plane oriented
+extern std::unique_ptr<HuguesHoppe::Spatial> SPp; // Point spatial partition
+extern std::unique_ptr<HuguesHoppe::Spatial> SPpc; // pcTPOrig spatial partition
+extern std::unique_ptr<HuguesHoppe::Graph<int>> gpcpseudo; // Riemannian on pc centers (based on co)
+extern HuguesHoppe::Mesh mesh; // Reconstructed surface
+
+// Reset the tangent plane arrays for n points and build the point spatial partition.
+// With mortonOrder, points becomes a copy of p[] sorted along a Morton curve, and all per point results
+// follow that order; pointOrder maps them back to p[].
+void setup_reconstruction(int n, const glm::vec3* p, const HuguesHoppe::Vec2<glm::vec3>& bound);
+// Tangent planes from the k nearest points, or through the points along normals (oriented, in the order of
+// the p[] given to setup_reconstruction()) if not NULL.
+// With tangentPlaneCacheDir, the oriented planes of the same points and settings are loaded from it if present,
+// as planes through pcTPOrig along pcTPNorm, and nothing is left to orient.
+void compute_tangent_planes(const glm::vec3* normals);
+// Orient the tangent planes that are not oriented yet; frees the Riemannian graph.
+// With tangentPlaneCacheDir, the planes so estimated and oriented are stored into it.
+void orient_tangent_planes();
+// Replace mesh with the zero set of the signed distance to the tangent planes.
+void contour_tangent_planes();
+// Estimated heap bytes of each structure, the contour nodes as of the last contour_tangent_planes().
+std::vector<std::pair<std::string, size_t>> reconstruction_memory();
+
+#endif // RECONSTRUCTION_H
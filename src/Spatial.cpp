@@ -12,14 +12,14 @@ namespace HuguesHoppe
 	void BPointSpatial::enter(int id, const glm::vec3* pp)
 	{
 		Ind ci = point_to_indices(*pp); assert(indices_inbounds(ci));
-		int en = encode(ci);
+		uint64_t en = encode(ci);
 		_map[en].push_back(Node(id, pp));
 	}
 
 	void BPointSpatial::remove(int id, const glm::vec3* pp)
 	{
 		Ind ci = point_to_indices(*pp); assert(indices_inbounds(ci));
-		int en = encode(ci);
+		uint64_t en = encode(ci);
 		std::vector<Node>& ar = _map.at(en);
 		int ind = -1; for_int(i, ar.size()) { if (ar[i].id == id) { assert(ind < 0); ind = i; } } assert(ind >= 0);
 		ar.erase(ar.begin() + ind);
@@ -31,16 +31,44 @@ namespace HuguesHoppe
 		for (auto& cell : _map) { cell.second.shrink_to_fit(); }
 	}
 
-	void BPointSpatial::add_cell(const Ind& ci, SPriority_Queue& pq, const glm::vec3& pcenter, std::set<int>&) const
+	size_t BPointSpatial::memory_usage() const
 	{
-		int en = encode(ci);
-		bool present = _map.find(en) != _map.end();
-		const std::vector<Node>& cell = _map.find(en)->second;
-		if (!present) return;
-		for (const Node& e : cell)
+		size_t bytes = hashBytes(_map);
+		for (const auto& cell : _map) { bytes += vectorBytes(cell.second); }
+		return bytes;
+	}
+
+	int BPointSpatial::radius_search(const glm::vec3& p, float radius, std::vector<int>& ids, std::vector<float>* dis2, int maxcount) const
+	{
+		float r2 = square(radius);
+		int count = 0;
+		scan_radius(p, radius, maxcount, [&](int i, int j, int k)
 		{
-			PQNode<Node> node = PQNode<Node>(e, glm::distance2(pcenter, *e.p));
-			pq.push(node);
+			auto it = _map.find(mortonEncode(uint32_t(i), uint32_t(j), uint32_t(k)));
+			if (it == _map.end()) return true;
+			for (const Node& e : it->second)
+			{
+				float d2 = glm::distance2(p, *e.p);
+				if (d2 > r2) continue;
+				ids.push_back(e.id);
+				if (dis2) dis2->push_back(d2);
+				if (++count >= maxcount) return false;
+			}
+			return true;
+		});
+		return count;
+	}
+
+	void BPointSpatial::add_cell(const Ind& ci, SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound& bound) const
+	{
+		auto it = _map.find(encode(ci));
+		if (it == _map.end()) return;
+		for (const Node& e : it->second)
+		{
+			float dis2 = glm::distance2(pcenter, *e.p);
+			if (dis2 > bound.dis2()) continue;
+			pq.push(PQNode<Node>(e, dis2));
+			bound.enter(dis2);
 		}
 	}
 
@@ -49,11 +77,676 @@ namespace HuguesHoppe
 		return id.id;
 	}
 
+	// *** GridPointSpatial
+
+	constexpr int GridPointSpatial::k_max_dense_gn;
+	constexpr int GridPointSpatial::k_scan_block; // bound to references by std::min
+
+	GridPointSpatial::GridPointSpatial(int gn, const Vec2<glm::vec3>& boxBound, int n, const glm::vec3* points)
+		: Spatial(gn, boxBound), _dense(gn <= k_max_dense_gn)
+	{
+		if (!_dense)
+		{
+			// Sort by cell key, then index, which keeps the points of a cell in index order
+			std::vector<std::pair<uint64_t, int>> order(n);
+			int nchunks = threadCount();
+			parallelFor(nchunks, [&](int chunk)
+			{
+				for (int i = int(int64_t(n) * chunk / nchunks), e = int(int64_t(n) * (chunk + 1) / nchunks); i < e; i++)
+				{
+					Ind ci = point_to_indices(points[i]); assert(indices_inbounds(ci));
+					order[i] = std::make_pair(encode(ci), i);
+				}
+			});
+			parallelSort(order, std::less<std::pair<uint64_t, int>>());
+			_ids.resize(n);
+			_x.resize(n); _y.resize(n); _z.resize(n);
+			for_int(k, n)
+			{
+				if (k == 0 || order[k].first != order[k - 1].first) { _cellkeys.push_back(order[k].first); _cellstart.push_back(k); }
+				int i = order[k].second;
+				_ids[k] = i;
+				_x[k] = points[i][0]; _y[k] = points[i][1]; _z[k] = points[i][2];
+			}
+			_cellstart.push_back(n);
+			return;
+		}
+
+		size_t ncells = size_t(_gn) * _gn * _gn;
+		std::vector<int> cells(n); // dense table indices, below k_max_dense_gn^3
+		// Chunks of consecutive points, counted and scattered separately so the result is stable
+		const int chunkSize = 1 << 16;
+		int nchunks = std::max(1, std::min(threadCount(), (n + chunkSize - 1) / chunkSize));
+		std::vector<std::vector<int>> counts(nchunks);
+		auto chunk_range = [&](int chunk, int& b, int& e) {
+			b = int(int64_t(n) * chunk / nchunks); e = int(int64_t(n) * (chunk + 1) / nchunks); };
+		parallelFor(nchunks, [&](int chunk)
+		{
+			std::vector<int>& count = counts[chunk];
+			count.assign(ncells, 0);
+			int b, e; chunk_range(chunk, b, e);
+			for (int i = b; i < e; i++)
+			{
+				Ind ci = point_to_indices(points[i]); assert(indices_inbounds(ci));
+				cells[i] = int(cell_index(int(ci[0]), int(ci[1]), int(ci[2])));
+				count[cells[i]]++;
+			}
+		});
+		// Exclusive prefix sum over (cell, chunk); counts become the scatter offsets
+		_cellstart.resize(ncells + 1);
+		int total = 0;
+		for (size_t c = 0; c < ncells; c++)
+		{
+			_cellstart[c] = total;
+			for_int(chunk, nchunks) { int k = counts[chunk][c]; counts[chunk][c] = total; total += k; }
+		}
+		_cellstart[ncells] = total;
+		assert(total == n);
+		_ids.resize(n);
+		_x.resize(n); _y.resize(n); _z.resize(n);
+		parallelFor(nchunks, [&](int chunk)
+		{
+			std::vector<int>& offset = counts[chunk];
+			int b, e; chunk_range(chunk, b, e);
+			for (int i = b; i < e; i++)
+			{
+				int k = offset[cells[i]]++;
+				_ids[k] = i;
+				_x[k] = points[i][0]; _y[k] = points[i][1]; _z[k] = points[i][2];
+			}
+		});
+	}
+
+	void GridPointSpatial::clear()
+	{
+		std::fill(_cellstart.begin(), _cellstart.end(), 0);
+		_ids.clear();
+		_x.clear(); _y.clear(); _z.clear();
+	}
+
+	size_t GridPointSpatial::memory_usage() const
+	{
+		return vectorBytes(_cellstart) + vectorBytes(_cellkeys) + vectorBytes(_ids) + vectorBytes(_x) + vectorBytes(_y) + vectorBytes(_z);
+	}
+
+	void GridPointSpatial::cell_range(int i, int j, int k, int& b, int& e) const
+	{
+		size_t c;
+		if (_dense) c = cell_index(i, j, k);
+		else
+		{
+			uint64_t key = mortonEncode(uint32_t(i), uint32_t(j), uint32_t(k));
+			auto it = std::lower_bound(_cellkeys.begin(), _cellkeys.end(), key);
+			if (it == _cellkeys.end() || *it != key) { b = e = 0; return; }
+			c = size_t(it - _cellkeys.begin());
+		}
+		b = _cellstart[c]; e = _cellstart[c + 1];
+	}
+
+	int GridPointSpatial::radius_search(const glm::vec3& p, float radius, std::vector<int>& ids, std::vector<float>* dis2, int maxcount) const
+	{
+		float r2 = square(radius);
+		int count = 0;
+		int sel[k_scan_block]; float seldis2[k_scan_block];
+		scan_radius(p, radius, maxcount, [&](int i, int j, int k)
+		{
+			int b, e; cell_range(i, j, k, b, e);
+			for (; b < e; b += k_scan_block)
+			{
+				int nsel = select_within(&_x[b], &_y[b], &_z[b], std::min(k_scan_block, e - b), p, r2, sel, seldis2);
+				for_int(s, nsel)
+				{
+					ids.push_back(_ids[b + sel[s]]);
+					if (dis2) dis2->push_back(seldis2[s]);
+					if (++count >= maxcount) return false;
+				}
+			}
+			return true;
+		});
+		return count;
+	}
+
+	void GridPointSpatial::add_cell(const Ind& ci, SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound& bound) const
+	{
+		int b, e; cell_range(int(ci[0]), int(ci[1]), int(ci[2]), b, e);
+		int sel[k_scan_block]; float dis2[k_scan_block];
+		// Blocks of the cell, so the bound tightens between blocks
+		for (; b < e; b += k_scan_block)
+		{
+			int nsel = select_within(&_x[b], &_y[b], &_z[b], std::min(k_scan_block, e - b), pcenter, bound.dis2(), sel, dis2);
+			for_int(j, nsel)
+			{
+				pq.push(PQNode<Node>(Node(b + sel[j], nullptr), dis2[j]));
+				bound.enter(dis2[j]);
+			}
+		}
+	}
+
+	int GridPointSpatial::pq_id(const Node& e) const
+	{
+		return _ids[e.id];
+	}
+
+	int GridPointSpatial::nearest(const glm::vec3& p, float* pdis2) const
+	{
+		static LocalStatCounter queries("spatial_nearest_queries");
+		queries += 1;
+		int best = -1; float bestdis2 = BIGFLOAT;
+		int sel[k_scan_block]; float dis2[k_scan_block];
+		scan_rings(p, bestdis2, [&](int i, int j, int k)
+		{
+			int b, e; cell_range(i, j, k, b, e);
+			for (; b < e; b += k_scan_block)
+			{
+				int nsel = select_within(&_x[b], &_y[b], &_z[b], std::min(k_scan_block, e - b), p, bestdis2, sel, dis2);
+				for_int(s, nsel) { if (dis2[s] < bestdis2) { bestdis2 = dis2[s]; best = b + sel[s]; } }
+			}
+		});
+		if (best < 0) return -1;
+		if (pdis2) *pdis2 = bestdis2;
+		return _ids[best];
+	}
+
+	// *** KdPointSpatial
+
+	KdPointSpatial::KdPointSpatial(const Vec2<glm::vec3>& boxBound, int n, const glm::vec3* points)
+		: Spatial(1, boxBound)
+	{
+		while (((int64_t(n) + (int64_t(1) << _depth) - 1) >> _depth) > k_leaf_size) _depth++;
+		int nleaves = 1 << _depth, firstLeaf = nleaves - 1;
+		_box.resize(2 * nleaves - 1);
+		std::vector<Vec2<int>> range(_box.size()); // [begin, end) of each node in order
+		std::vector<int> order(n);
+		for_int(i, n) { order[i] = i; }
+		range[0] = Vec2<int>(0, n);
+		auto bound = [&](int node)
+		{
+			Vec2<glm::vec3>& box = _box[node];
+			box = Vec2<glm::vec3>(glm::vec3(BIGFLOAT), glm::vec3(-BIGFLOAT));
+			for (int k = range[node][0]; k < range[node][1]; k++)
+			{
+				for_int(c, 3) { box[0][c] = std::min(box[0][c], points[order[k]][c]); box[1][c] = std::max(box[1][c], points[order[k]][c]); }
+			}
+		};
+		// Split each level at the median of the widest axis, the nodes of a level in parallel
+		for_int(level, _depth)
+		{
+			int first = (1 << level) - 1;
+			parallelFor(1 << level, [&](int t)
+			{
+				int node = first + t, b = range[node][0], e = range[node][1], mid = b + (e - b) / 2;
+				bound(node);
+				glm::vec3 size = _box[node][1] - _box[node][0];
+				int axis = size[0] >= size[1] && size[0] >= size[2] ? 0 : size[1] >= size[2] ? 1 : 2;
+				std::nth_element(order.begin() + b, order.begin() + mid, order.begin() + e,
+					[&](int i, int j) { return points[i][axis] < points[j][axis]; });
+				range[2 * node + 1] = Vec2<int>(b, mid);
+				range[2 * node + 2] = Vec2<int>(mid, e);
+			});
+		}
+		size_t nslots = size_t(nleaves) * k_leaf_size;
+		_count.resize(nleaves);
+		_x.assign(nslots, BIGFLOAT); _y.assign(nslots, BIGFLOAT); _z.assign(nslots, BIGFLOAT);
+		_ids.assign(nslots, -1);
+		parallelFor(nleaves, [&](int leaf)
+		{
+			int node = firstLeaf + leaf, b = range[node][0];
+			bound(node);
+			_count[leaf] = range[node][1] - b;
+			assert(_count[leaf] <= k_leaf_size);
+			for_int(j, _count[leaf])
+			{
+				size_t slot = size_t(leaf) * k_leaf_size + j;
+				const glm::vec3& p = points[order[b + j]];
+				_x[slot] = p[0]; _y[slot] = p[1]; _z[slot] = p[2];
+				_ids[slot] = order[b + j];
+			}
+		});
+	}
+
+	void KdPointSpatial::clear()
+	{
+		_depth = 0;
+		_box.clear(); _count.clear();
+		_x.clear(); _y.clear(); _z.clear();
+		_ids.clear();
+	}
+
+	size_t KdPointSpatial::memory_usage() const
+	{
+		return vectorBytes(_box) + vectorBytes(_count) + vectorBytes(_x) + vectorBytes(_y) + vectorBytes(_z) + vectorBytes(_ids);
+	}
+
+	float KdPointSpatial::box_dis2(int node, const glm::vec3& p) const
+	{
+		const Vec2<glm::vec3>& box = _box[node];
+		float dis2 = 0.f;
+		for_int(c, 3) { dis2 += square(std::max(0.f, std::max(box[0][c] - p[c], p[c] - box[1][c]))); }
+		return dis2;
+	}
+
+	int KdPointSpatial::radius_search(const glm::vec3& p, float radius, std::vector<int>& ids, std::vector<float>* dis2, int maxcount) const
+	{
+		if (_depth == 0 && (_count.empty() || !_count[0])) return 0; // no points
+		float r2 = square(radius);
+		int firstLeaf = (1 << _depth) - 1, count = 0;
+		int stack[64], nstack = 0;
+		stack[nstack++] = 0;
+		while (nstack)
+		{
+			int node = stack[--nstack];
+			if (box_dis2(node, p) > r2) continue;
+			if (node < firstLeaf)
+			{
+				stack[nstack++] = 2 * node + 2;
+				stack[nstack++] = 2 * node + 1;
+				continue;
+			}
+			int leaf = node - firstLeaf;
+			size_t first = size_t(leaf) * k_leaf_size;
+			int sel[k_leaf_size]; float seldis2[k_leaf_size];
+			int nsel = select_within(&_x[first], &_y[first], &_z[first], _count[leaf], p, r2, sel, seldis2);
+			for_int(j, nsel)
+			{
+				ids.push_back(_ids[first + sel[j]]);
+				if (dis2) dis2->push_back(seldis2[j]);
+				if (++count >= maxcount) return count;
+			}
+		}
+		return count;
+	}
+
+	// Tree nodes are queue entries with negative ids (-1 - node), points have their slot as id.
+	// A node's priority is its box distance scaled by _epsfactor, so approximate searches open fewer nodes.
+	void KdPointSpatial::add_cell(const Ind&, SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound&) const
+	{
+		if (_depth == 0 && (_count.empty() || !_count[0])) return; // no points
+		pq.push(PQNode<Node>(Node(-1, nullptr), box_dis2(0, pcenter) * _epsfactor));
+	}
+
+	void KdPointSpatial::pq_refine(SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound& bound) const
+	{
+		int firstLeaf = (1 << _depth) - 1;
+		while (!pq.empty() && pq.top()._e.id < 0)
+		{
+			int node = -1 - pq.top()._e.id;
+			pq.pop();
+			if (node < firstLeaf)
+			{
+				for_intL(child, 2 * node + 1, 2 * node + 3)
+				{
+					float dis2 = box_dis2(child, pcenter) * _epsfactor;
+					if (dis2 <= bound.dis2()) pq.push(PQNode<Node>(Node(-1 - child, nullptr), dis2));
+				}
+				continue;
+			}
+			int leaf = node - firstLeaf;
+			size_t first = size_t(leaf) * k_leaf_size;
+			int sel[k_leaf_size]; float dis2[k_leaf_size];
+			int nsel = select_within(&_x[first], &_y[first], &_z[first], _count[leaf], pcenter, bound.dis2(), sel, dis2);
+			for_int(j, nsel)
+			{
+				pq.push(PQNode<Node>(Node(int(first) + sel[j], nullptr), dis2[j]));
+				bound.enter(dis2[j]);
+			}
+		}
+	}
+
+	int KdPointSpatial::pq_id(const Node& e) const
+	{
+		return _ids[e.id];
+	}
+
+	// Depth-first descent into the nearer child first, skipping the nodes whose box is farther than the best point
+	// (by the factor _epsfactor for approximate searches).
+	int KdPointSpatial::nearest(const glm::vec3& p, float* pdis2) const
+	{
+		static LocalStatCounter queries("spatial_nearest_queries");
+		queries += 1;
+		if (_depth == 0 && (_count.empty() || !_count[0])) return -1; // no points
+		int firstLeaf = (1 << _depth) - 1;
+		int best = -1; float bestdis2 = BIGFLOAT;
+		int stack[64]; float stackdis2[64]; int nstack = 0;
+		stack[nstack] = 0; stackdis2[nstack++] = box_dis2(0, p) * _epsfactor;
+		while (nstack)
+		{
+			nstack--;
+			int node = stack[nstack];
+			if (stackdis2[nstack] > bestdis2) continue;
+			if (node < firstLeaf)
+			{
+				int c0 = 2 * node + 1, c1 = 2 * node + 2; // c0 nearer, so pushed last
+				float dis20 = box_dis2(c0, p) * _epsfactor, dis21 = box_dis2(c1, p) * _epsfactor;
+				if (dis21 < dis20) { std::swap(c0, c1); std::swap(dis20, dis21); }
+				if (dis21 <= bestdis2) { stack[nstack] = c1; stackdis2[nstack++] = dis21; }
+				if (dis20 <= bestdis2) { stack[nstack] = c0; stackdis2[nstack++] = dis20; }
+				continue;
+			}
+			int leaf = node - firstLeaf;
+			size_t first = size_t(leaf) * k_leaf_size;
+			int sel[k_leaf_size]; float dis2[k_leaf_size];
+			int nsel = select_within(&_x[first], &_y[first], &_z[first], _count[leaf], p, bestdis2, sel, dis2);
+			for_int(s, nsel) { if (dis2[s] < bestdis2) { bestdis2 = dis2[s]; best = int(first) + sel[s]; } }
+		}
+		if (best < 0) return -1;
+		if (pdis2) *pdis2 = bestdis2;
+		return _ids[best];
+	}
+
+	// *** DynamicPointSpatial
+
+	DynamicPointSpatial::DynamicPointSpatial(int gn, const Vec2<glm::vec3>& boxBound)
+		: Spatial(gn, boxBound), _dense(gn <= GridPointSpatial::k_max_dense_gn)
+	{
+		if (_dense) _cellslot.assign(size_t(_gn) * _gn * _gn, -1);
+		clear_extent();
+	}
+
+	void DynamicPointSpatial::clear_extent()
+	{
+		_cellmin = glm::ivec3(_gn); _cellmax = glm::ivec3(-1);
+	}
+
+	void DynamicPointSpatial::extend(const glm::vec3& p)
+	{
+		for_int(c, 3)
+		{
+			int i = float_to_index_clamped(c, p[c]);
+			_cellmin[c] = std::min(_cellmin[c], i); _cellmax[c] = std::max(_cellmax[c], i);
+		}
+	}
+
+	void DynamicPointSpatial::clear()
+	{
+		std::fill(_cellslot.begin(), _cellslot.end(), -1);
+		_cellmap.clear();
+		_cells.clear();
+		_loc.clear();
+		_size = 0;
+		_nempty = 0;
+		clear_extent();
+	}
+
+	size_t DynamicPointSpatial::memory_usage() const
+	{
+		size_t bytes = vectorBytes(_cellslot) + hashBytes(_cellmap) + vectorBytes(_cells) + vectorBytes(_loc);
+		for (const Cell& cell : _cells) { bytes += vectorBytes(cell.ids) + vectorBytes(cell.x) + vectorBytes(cell.y) + vectorBytes(cell.z); }
+		return bytes;
+	}
+
+	uint64_t DynamicPointSpatial::point_cell(const glm::vec3& p) const
+	{
+		return cell_key(float_to_index_clamped(0, p[0]), float_to_index_clamped(1, p[1]), float_to_index_clamped(2, p[2]));
+	}
+
+	int DynamicPointSpatial::cell_slot(uint64_t key) const
+	{
+		if (_dense) return _cellslot[size_t(key)];
+		auto it = _cellmap.find(key);
+		return it == _cellmap.end() ? -1 : it->second;
+	}
+
+	void DynamicPointSpatial::set_cell_slot(uint64_t key, int slot)
+	{
+		if (_dense) _cellslot[size_t(key)] = slot;
+		else if (slot < 0) _cellmap.erase(key);
+		else _cellmap[key] = slot;
+	}
+
+	int DynamicPointSpatial::cell_for_insert(uint64_t key, int nadd)
+	{
+		int slot = cell_slot(key);
+		if (slot < 0)
+		{
+			slot = int(_cells.size());
+			set_cell_slot(key, slot);
+			_cells.emplace_back();
+			_cells.back().key = key;
+		}
+		else if (_cells[slot].ids.empty()) _nempty--;
+		Cell& cell = _cells[slot];
+		size_t n = cell.ids.size() + nadd;
+		if (n > cell.ids.capacity())
+		{
+			n = std::max(n, 2 * cell.ids.capacity());
+			cell.ids.reserve(n); cell.x.reserve(n); cell.y.reserve(n); cell.z.reserve(n);
+		}
+		return slot;
+	}
+
+	void DynamicPointSpatial::append(int slot, int id, const glm::vec3& p)
+	{
+		assert(id >= 0 && !contains(id));
+		if (id >= int(_loc.size())) _loc.resize(std::max(size_t(id) + 1, 2 * _loc.size()));
+		Cell& cell = _cells[slot];
+		_loc[id].cell = slot;
+		_loc[id].slot = int(cell.ids.size());
+		cell.ids.push_back(id);
+		cell.x.push_back(p[0]); cell.y.push_back(p[1]); cell.z.push_back(p[2]);
+		_size++;
+		extend(p);
+	}
+
+	void DynamicPointSpatial::enter(int id, const glm::vec3& p)
+	{
+		append(cell_for_insert(point_cell(p), 1), id, p);
+	}
+
+	void DynamicPointSpatial::enter(int n, const int* ids, const glm::vec3* points)
+	{
+		// Sorted by cell, so each cell is looked up and grown once; a cell keeps the points in batch order
+		std::vector<std::pair<uint64_t, int>> keyed(n);
+		for_int(i, n) { keyed[i] = std::make_pair(point_cell(points[i]), i); }
+		parallelSort(keyed, [](const std::pair<uint64_t, int>& a, const std::pair<uint64_t, int>& b) { return a < b; });
+		for (int b = 0, e; b < n; b = e)
+		{
+			uint64_t key = keyed[b].first;
+			for (e = b + 1; e < n && keyed[e].first == key; e++) { }
+			int slot = cell_for_insert(key, e - b);
+			for (int k = b; k < e; k++) { append(slot, ids[keyed[k].second], points[keyed[k].second]); }
+		}
+	}
+
+	void DynamicPointSpatial::remove(int id)
+	{
+		assert(contains(id));
+		Location& loc = _loc[id];
+		Cell& cell = _cells[loc.cell];
+		int last = int(cell.ids.size()) - 1;
+		if (loc.slot != last)
+		{
+			cell.ids[loc.slot] = cell.ids[last];
+			cell.x[loc.slot] = cell.x[last]; cell.y[loc.slot] = cell.y[last]; cell.z[loc.slot] = cell.z[last];
+			_loc[cell.ids[loc.slot]].slot = loc.slot;
+		}
+		cell.ids.pop_back();
+		cell.x.pop_back(); cell.y.pop_back(); cell.z.pop_back();
+		loc.slot = -1;
+		_size--;
+		if (cell.ids.empty() && 2 * ++_nempty > int(_cells.size())) compact();
+	}
+
+	void DynamicPointSpatial::compact()
+	{
+		// Each dropped cell was emptied by a removal, and an array is trimmed only once it is a quarter used,
+		// so compaction is amortized over the removals.
+		for (int slot = 0; slot < int(_cells.size()); )
+		{
+			Cell& cell = _cells[slot];
+			if (cell.ids.empty())
+			{
+				set_cell_slot(cell.key, -1);
+				if (slot != int(_cells.size()) - 1)
+				{
+					cell = std::move(_cells.back());
+					set_cell_slot(cell.key, slot);
+					for (int id : cell.ids) { _loc[id].cell = slot; }
+				}
+				_cells.pop_back();
+				continue;
+			}
+			if (4 * cell.ids.size() <= cell.ids.capacity())
+			{
+				cell.ids.shrink_to_fit(); cell.x.shrink_to_fit(); cell.y.shrink_to_fit(); cell.z.shrink_to_fit();
+			}
+			slot++;
+		}
+		if (4 * _cells.size() <= _cells.capacity()) _cells.shrink_to_fit();
+		_nempty = 0;
+		clear_extent();
+		for (const Cell& cell : _cells) { extend(glm::vec3(cell.x[0], cell.y[0], cell.z[0])); }
+	}
+
+	int DynamicPointSpatial::radius_search(const glm::vec3& p, float radius, std::vector<int>& ids, std::vector<float>* dis2, int maxcount) const
+	{
+		if (!_size) return 0;
+		float r2 = square(radius);
+		int count = 0;
+		const int block = GridPointSpatial::k_scan_block;
+		int sel[block]; float seldis2[block];
+		scan_radius(p, radius, maxcount, [&](int i, int j, int k)
+		{
+			const Cell* cell = find_cell(cell_key(i, j, k));
+			if (!cell) return true;
+			for (int b = 0, e = int(cell->ids.size()); b < e; b += block)
+			{
+				int nsel = select_within(&cell->x[b], &cell->y[b], &cell->z[b], std::min(block, e - b), p, r2, sel, seldis2);
+				for_int(s, nsel)
+				{
+					ids.push_back(cell->ids[b + sel[s]]);
+					if (dis2) dis2->push_back(seldis2[s]);
+					if (++count >= maxcount) return false;
+				}
+			}
+			return true;
+		});
+		return count;
+	}
+
+	int DynamicPointSpatial::nearest(const glm::vec3& p, float* pdis2) const
+	{
+		static LocalStatCounter queries("spatial_nearest_queries");
+		queries += 1;
+		if (!_size) return -1;
+		int best = -1; float bestdis2 = BIGFLOAT;
+		const int block = GridPointSpatial::k_scan_block;
+		int sel[block]; float dis2[block];
+		scan_rings(p, bestdis2, [&](int i, int j, int k)
+		{
+			const Cell* cell = find_cell(cell_key(i, j, k));
+			if (!cell) return;
+			for (int b = 0, e = int(cell->ids.size()); b < e; b += block)
+			{
+				int nsel = select_within(&cell->x[b], &cell->y[b], &cell->z[b], std::min(block, e - b), p, bestdis2, sel, dis2);
+				for_int(s, nsel) { if (dis2[s] < bestdis2) { bestdis2 = dis2[s]; best = cell->ids[b + sel[s]]; } }
+			}
+		});
+		if (best < 0) return -1;
+		if (pdis2) *pdis2 = bestdis2;
+		return best;
+	}
+
+	void DynamicPointSpatial::add_cell(const Ind& ci, SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound& bound) const
+	{
+		const Cell* cell = find_cell(cell_key(int(ci[0]), int(ci[1]), int(ci[2])));
+		if (!cell) return;
+		const int block = GridPointSpatial::k_scan_block;
+		int sel[block]; float dis2[block];
+		for (int b = 0, e = int(cell->ids.size()); b < e; b += block)
+		{
+			int nsel = select_within(&cell->x[b], &cell->y[b], &cell->z[b], std::min(block, e - b), pcenter, bound.dis2(), sel, dis2);
+			for_int(j, nsel)
+			{
+				pq.push(PQNode<Node>(Node(cell->ids[b + sel[j]], nullptr), dis2[j]));
+				bound.enter(dis2[j]);
+			}
+		}
+	}
+
+	int DynamicPointSpatial::pq_id(const Node& e) const
+	{
+		return e.id;
+	}
+
+	// *** Spatial
+
+	void Spatial::knn(int nq, const glm::vec3* queries, int k, int* ids, float* dis2) const
+	{
+		const int blockSize = 256;
+		int nblocks = (nq + blockSize - 1) / blockSize;
+		parallelFor(nblocks, [&](int block)
+		{
+			for (int q = block * blockSize, e = std::min(nq, q + blockSize); q < e; q++)
+			{
+				int* qids = ids + size_t(q) * k;
+				float* qdis2 = dis2 + size_t(q) * k;
+				BSpatialSearch ss(*this, queries[q], 10.f, k);
+				for_int(j, k)
+				{
+					if (ss.done()) { qids[j] = -1; qdis2[j] = BIGFLOAT; continue; }
+					qids[j] = ss.next(&qdis2[j]);
+				}
+			}
+		});
+	}
+
+	float Spatial::cell_gap(int axis, int i, float f) const
+	{
+		// Cell i spans [min + i*w, min + (i+1)*w), the end cells extended outward by the clamping of
+		// float_to_index_clamped(); the slack covers its rounding.
+		float min = _boxBounds[0][axis], max = _boxBounds[1][axis], w = (max - min) * _gni;
+		float slack = 1e-5f * (std::abs(min) + std::abs(max));
+		float lo = min + i * w - slack, hi = min + (i + 1) * w + slack;
+		if (i > _cellmin[axis] && f < lo) return lo - f;
+		if (i < _cellmax[axis] && f > hi) return f - hi;
+		return 0.f;
+	}
+
+	int Spatial::nearest(const glm::vec3& p, float* dis2) const
+	{
+		BSpatialSearch ss(*this, p, 10.f, 1);
+		if (ss.done()) return -1;
+		return ss.next(dis2);
+	}
+
 	// *** SpatialSearch
 
-	BSpatialSearch::BSpatialSearch(const Spatial& sp, const glm::vec3& p, float maxdis)
-		: _sp(sp), _pcenter(p), _maxdis(maxdis)
+	// Storage of the searches alive on a thread, kept for the later searches of the thread.
+	// Searches nest, so storage is taken and given back in stack order; taking it only clears it,
+	// which keeps its capacity, so once a thread has warmed up its searches do not allocate.
+	struct SpatialSearchContext
+	{
+		std::vector<std::unique_ptr<SpatialSearchStorage>> storage;
+		int ntaken{ 0 };
+	};
+
+	static SpatialSearchContext& search_context()
 	{
+		static thread_local SpatialSearchContext context;
+		return context;
+	}
+
+	SpatialSearchStorage& BSpatialSearch::take_storage(int& slot)
+	{
+		SpatialSearchContext& context = search_context();
+		if (context.ntaken == int(context.storage.size())) context.storage.push_back(std::make_unique<SpatialSearchStorage>());
+		slot = context.ntaken++;
+		SpatialSearchStorage& storage = *context.storage[slot];
+		storage.pq.clear();
+		return storage;
+	}
+
+	void BSpatialSearch::give_back_storage(int slot)
+	{
+		// A search outliving a later one of its thread would hand the later one's storage to the next search
+		assert(slot == search_context().ntaken - 1);
+		search_context().ntaken = slot;
+	}
+
+	BSpatialSearch::BSpatialSearch(const Spatial& sp, const glm::vec3& p, float maxdis, int k)
+		: _sp(sp), _pcenter(p), _maxdis(maxdis), _storage(take_storage(_slot)), _pq(_storage.pq)
+	{
+		_storage.bound.reset(k);
 		Ind ci = _sp.point_to_indices(_pcenter);
 		assert(_sp.indices_inbounds(ci));
 		for_int(i, 2) for_int(c, 3) { _ssi[i][c] = ci[c]; }
@@ -61,6 +754,17 @@ namespace HuguesHoppe
 		get_closest_next_cell();
 	}
 
+	BSpatialSearch::~BSpatialSearch()
+	{
+		static LocalStatCounter searches("spatial_searches");
+		static LocalStatCounter cells("spatial_cells_visited");
+		static LocalStatCounter elements("spatial_elements_visited");
+		searches += 1;
+		cells += _ncellsv;
+		elements += _nelemsv;
+		give_back_storage(_slot);
+	}
+
 	bool BSpatialSearch::done()
 	{
 		for (;;) {
@@ -76,12 +780,12 @@ namespace HuguesHoppe
 		for (;;) {
 			if (_pq.empty()) assert(!done()); // refill _pq
 			float dis2 = _pq.top()._pri;
-			if (dis2 > _disbv2) {
+			if (dis2 > _disbv2 * _sp._epsfactor) {
 				expand_search_space();
 				continue;
 			}
 			u = _pq.top()._e;
-			_sp.pq_refine(_pq, _pcenter);
+			_sp.pq_refine(_pq, _pcenter, _storage.bound);
 			if (_pq.top()._e != u || _pq.top()._pri != dis2) continue;
 			if (pdis2) *pdis2 = _pq.top()._pri;
 			u = _pq.top()._e;
@@ -95,20 +799,22 @@ namespace HuguesHoppe
 	{
 		_ncellsv++;
 		int n = _pq.size();
-		_sp.add_cell(ci, _pq, _pcenter, _setevis);
+		_sp.add_cell(ci, _pq, _pcenter, _storage.bound);
 		_nelemsv += _pq.size() - n;
 	}
 
 	void BSpatialSearch::get_closest_next_cell()
 	{
+		// The next layer on each side is bounded by its gap from _pcenter along the axis; cells past
+		// _cellmin/_cellmax never hold elements.
 		float mindis = 1e10f;
 		for_int(c, 3) {
-			if (_ssi[0][c]>0) {
-				float a = _pcenter[c] - _sp.index_to_float(_ssi[0][c]);
+			if (_ssi[0][c]>_sp._cellmin[c]) {
+				float a = _sp.cell_gap(c, int(_ssi[0][c]) - 1, _pcenter[c]);
 				if (a<mindis) { mindis = a; _axis = c; _dir = 0; }
 			}
-			if (_ssi[1][c]<_sp._gn - 1) {
-				float a = _sp.index_to_float(_ssi[1][c] + 1) - _pcenter[c];
+			if (_ssi[1][c]<_sp._cellmax[c]) {
+				float a = _sp.cell_gap(c, int(_ssi[1][c]) + 1, _pcenter[c]);
 				if (a<mindis) { mindis = a; _axis = c; _dir = 1; }
 			}
 		}
@@ -122,7 +828,8 @@ namespace HuguesHoppe
 		Vec2<Ind> bi = _ssi;
 		_ssi[_dir][_axis] += _dir ? 1 : -1;
 		bi[0][_axis] = bi[1][_axis] = _ssi[_dir][_axis];
-		// consider the layer whose axis's value is _ssi[_dir][_axis]
+		// consider the layer whose axis's value is _ssi[_dir][_axis], within the cells that can hold elements
+		for_int(c, 3) { bi[0][c] = float(std::max(int(bi[0][c]), _sp._cellmin[c])); bi[1][c] = float(std::min(int(bi[1][c]), _sp._cellmax[c])); }
 		Ind temp = glm::ivec3(bi[1][0] + 1, bi[1][1] + 1, bi[1][2] + 1);
 		for (const Ind& cit : coordsL<3>(bi[0], temp)) { consider(cit); }
 		get_closest_next_cell();
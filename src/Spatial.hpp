@@ -3,6 +3,7 @@
 #define SPATIAL_H
 
 #include "includes/includes.hpp"
+#include "SpatialKernels.hpp"
 
 namespace HuguesHoppe
 {
@@ -36,37 +37,116 @@ namespace HuguesHoppe
 
 	using SPriority_Queue = std::priority_queue<PQNode<Node>, std::vector<PQNode<Node>>, cmp>;
 
+	// SPriority_Queue that keeps its storage when cleared, to reuse it across searches.
+	class SPriority_Queue_Reusable : public SPriority_Queue
+	{
+	public:
+		void clear() { c.clear(); }
+	};
+
+	// Bound on the squared distance of the elements worth entering into a search queue.
+	// A search for at most k elements keeps the k smallest squared distances entered so far:
+	// elements farther than the largest of them can never be returned.
+	class SearchBound
+	{
+	public:
+		void reset(int k) { _k = k; _heap.clear(); _dis2 = BIGFLOAT; } // k == 0: unbounded
+		float dis2() const { return _dis2; }
+		void enter(float dis2)
+		{
+			if (!_k) return;
+			if (int(_heap.size()) < _k)
+			{
+				_heap.push_back(dis2); std::push_heap(_heap.begin(), _heap.end());
+				if (int(_heap.size()) == _k) _dis2 = _heap.front();
+			}
+			else if (dis2 < _heap.front())
+			{
+				std::pop_heap(_heap.begin(), _heap.end()); _heap.back() = dis2; std::push_heap(_heap.begin(), _heap.end());
+				_dis2 = _heap.front();
+			}
+		}
+	private:
+		int _k{ 0 };
+		std::vector<float> _heap; // max-heap of the k smallest squared distances entered
+		float _dis2{ BIGFLOAT };
+	};
+
+	// Storage of a BSpatialSearch, kept by its thread for later searches.
+	struct SpatialSearchStorage
+	{
+		SPriority_Queue_Reusable pq;
+		SearchBound bound;
+	};
+
 	using Ind = glm::vec3;
 
 	// Spatial data structure for efficient queries like "closest_elements" or "find_elements_intersecting_ray".
 	class Spatial : noncopyable // abstract class
 	{
-		static constexpr int k_max_gn = 1023; // 10 bits per coordinate
+		static constexpr int k_max_gn = 1 << mortonBits; // 21 bits per coordinate in a 64-bit key
 	public:
 		explicit Spatial(int gn, const Vec2<glm::vec3>& boxBound) : 
-			_gn(gn), _boxBounds(boxBound) { assert(_gn <= k_max_gn); _gni = 1.f / float(_gn); }
+			_gn(gn), _boxBounds(boxBound)
+		{
+			assert(_gn <= k_max_gn); _gni = 1.f / float(_gn);
+			for_int(c, 3) { _cellmin[c] = float_to_index_clamped(c, _boxBounds[0][c]); _cellmax[c] = float_to_index_clamped(c, _boxBounds[1][c]); }
+		}
 		virtual ~Spatial() { } // not =default because gcc "looser throw specified" in derived
 		virtual void clear() = 0;
+		virtual size_t memory_usage() const = 0; // estimated heap bytes
+		// The k nearest elements to each of the nq points queries[], nearest first, in ids[q*k+j] with squared
+		// distances in dis2[q*k+j]. Slots past the number of elements get id -1. Runs on threadCount() threads.
+		void knn(int nq, const glm::vec3* queries, int k, int* ids, float* dis2) const;
+		// Append to ids (and dis2 if not null) the elements within radius of p and their squared distances,
+		// in no particular order, stopping after maxcount of them. Returns the number appended.
+		virtual int radius_search(const glm::vec3& p, float radius, std::vector<int>& ids,
+			std::vector<float>* dis2 = nullptr, int maxcount = INT_MAX) const = 0;
+		// The element nearest to p, with its squared distance in dis2 if not null; -1 if there are none.
+		// The default runs a BSpatialSearch for one element; backends override it with a search without a queue.
+		virtual int nearest(const glm::vec3& p, float* dis2 = nullptr) const;
+		// Approximate searches: each element returned may be up to (1 + eps) times farther than the nearest one
+		// not yet returned, which lets them stop expanding sooner. 0 (the default) is exact.
+		void set_epsilon(float eps) { assert(eps >= 0.f); _eps = eps; _epsfactor = square(1.f + eps); }
+		float epsilon() const { return _eps; }
 	protected:
 		friend class BSpatialSearch;
 		int _gn;                    // grid size
 		float _gni;                 // 1/_gn
 		Vec2<glm::vec3> _boxBounds;
+		glm::ivec3 _cellmin, _cellmax; // per axis, range of the cells that can hold elements (empty if min > max)
+		float _eps{ 0.f };             // approximation of the searches
+		float _epsfactor{ 1.f };       // square(1 + _eps), scales the lower bounds on squared distances
 									//
 		int inbounds(int i) const { return i >= 0 && i<_gn; }
 		int indices_inbounds(const Ind& ci) const { return inbounds(ci[0]) && inbounds(ci[1]) && inbounds(ci[2]); }
 		int float_to_index(int axis, float fd) const;
+		int float_to_index_clamped(int axis, float fd) const; // same without the bounds check
+		// Range of cells [ci0, ci1] (inclusive) that may hold elements within the box [p0, p1]
+		void box_to_indices(const glm::vec3& p0, const glm::vec3& p1, Ind& ci0, Ind& ci1) const
+		{
+			for_int(c, 3) { ci0[c] = float_to_index_clamped(c, p0[c]); ci1[c] = float_to_index_clamped(c, p1[c]); }
+		}
 		float index_to_float(int i) const { return i*_gni; }
 		Ind point_to_indices(const glm::vec3& p) const { Ind ci; for_int(c,3) { ci[c] = float_to_index(c, p[c]); } return ci; }
 		glm::vec3 indices_to_point(const Ind& ci) const { glm::vec3 p; for_int(c, 3) { p[c] = index_to_float(ci[c]); } return p; }
-		int encode(const Ind& ci) const { return (int(ci[0]) << 20) | (int(ci[1]) << 10) | int(ci[2]); } // k_max_gn implied here
-		Ind decode(int en) const;
+		uint64_t encode(const Ind& ci) const { return mortonEncode(uint32_t(ci[0]), uint32_t(ci[1]), uint32_t(ci[2])); }
+		Ind decode(uint64_t en) const;
+		float cell_gap(int axis, int i, float f) const; // lower bound on the distance along axis from f to cell i
+		// Call scan_cell(i, j, k) on the cells in rings of growing Chebyshev distance around the cell of p, skipping
+		// those farther than bestdis2 and stopping at the first ring that is; scan_cell lowers bestdis2 as it goes.
+		// Unless exact, the distances are scaled by the approximation epsilon.
+		template<typename ScanCell> void scan_rings(const glm::vec3& p, const float& bestdis2, ScanCell scan_cell, bool exact = false) const;
+		// Call scan_cell(i, j, k) on the cells that may hold elements within radius of p, until it returns false.
+		// Searches for at most k_outward_maxcount elements go outward from the cell of p, so they stop sooner.
+		static constexpr int k_outward_maxcount = 16;
+		template<typename ScanCell> void scan_radius(const glm::vec3& p, float radius, int maxcount, ScanCell scan_cell) const;
 		// for BSpatialSearch:
-		// Add elements from cell ci to priority queue with priority equal to distance from pcenter squared.
-		// May use set to avoid duplication.
-		virtual void add_cell(const Ind& ci, SPriority_Queue& pq, const glm::vec3& pcenter, std::set<int>& set) const = 0;
+		// Add elements from cell ci to priority queue with priority equal to distance from pcenter squared,
+		// skipping those farther than bound.dis2() and entering the others into bound.
+		virtual void add_cell(const Ind& ci, SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound& bound) const = 0;
 		// Refine distance estimate of first entry in pq (optional)
-		virtual void pq_refine(SPriority_Queue& pq, const glm::vec3& pcenter) const { dummy_use(pq, pcenter); }
+		virtual void pq_refine(SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound& bound) const { dummy_use(pq, pcenter, bound); }
 		virtual int pq_id(const Node& pqe) const = 0; // given pq entry, return id
 	};
 
@@ -80,10 +160,12 @@ namespace HuguesHoppe
 		void enter(int id, const glm::vec3* pp);  // note: pp not copied, no ownership taken
 		void remove(int id, const glm::vec3* pp); // must exist, else die
 		void shrink_to_fit();                  // often just fragments memory
+		size_t memory_usage() const override;
+		int radius_search(const glm::vec3& p, float radius, std::vector<int>& ids, std::vector<float>* dis2, int maxcount) const override;
 	private:
-		void add_cell(const Ind& ci, SPriority_Queue& pq, const glm::vec3& pcenter, std::set<int>& set) const override;
+		void add_cell(const Ind& ci, SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound& bound) const override;
 		int pq_id(const Node& pqe) const override;
-		std::unordered_map<int, std::vector<Node>> _map; // encoded cube index -> Array
+		std::unordered_map<uint64_t, std::vector<Node>> _map; // encoded cube index -> Array
 	};
 
 	// Search for nearest element(s) from a given query point.
@@ -91,8 +173,9 @@ namespace HuguesHoppe
 	{
 	public:
 		// pmaxdis is only a request, you may get objects that lie farther
-		BSpatialSearch(const Spatial& sp, const glm::vec3& p, float maxdis = 10.f);
-		~BSpatialSearch() {}
+		// With k > 0 at most k elements may be asked for, so farther candidates are not entered into the queue.
+		BSpatialSearch(const Spatial& sp, const glm::vec3& p, float maxdis = 10.f, int k = 0);
+		~BSpatialSearch(); // adds the visit counts to the run statistics, gives back the storage
 		bool done();
 		int next(float* dis2 = nullptr); // ret id
 	private:
@@ -100,15 +183,18 @@ namespace HuguesHoppe
 		const Spatial& _sp;
 		const glm::vec3 _pcenter;
 		float _maxdis;
-		SPriority_Queue _pq;           // pq of entries by distance
+		int _slot;                     // of _storage in the thread's search context
+		SpatialSearchStorage& _storage; // taken from the thread's search context
+		SPriority_Queue& _pq;          // pq of entries by distance
 		Vec2<Ind> _ssi;             // search space indices (extents)
 		float _disbv2{ 0.f };        // distance to search space boundary
 		int _axis;                  // axis to expand next
 		int _dir;                   // direction in which to expand next (0, 1)
-		std::set<int> _setevis;         // may be used by add_cell()
 		int _ncellsv{ 0 };
 		int _nelemsv{ 0 };
 		//
+		static SpatialSearchStorage& take_storage(int& slot);
+		static void give_back_storage(int slot); // the last slot taken
 		void get_closest_next_cell();
 		void expand_search_space();
 		void consider(const Ind& ci);
@@ -118,27 +204,63 @@ namespace HuguesHoppe
 	//----------------------------------------------------------------------------
 
 	inline int Spatial::float_to_index(int axis, float fd) const
+	{
+		assert(fd >= _boxBounds[0][axis] - 0.1f && fd <= _boxBounds[1][axis] + 0.1f);
+		return float_to_index_clamped(axis, fd);
+	}
+
+	inline int Spatial::float_to_index_clamped(int axis, float fd) const
 	{
 		float f = fd, min = _boxBounds[0][axis], max = _boxBounds[1][axis];
 		float dis = 0.1f;
-		if (f <= min + dis) { assert(f >= min - dis); f = min + dis; }
-		if (f >= max - dis) { assert(f <= max + dis); f = max - dis; }
+		if (f <= min + dis) f = min + dis;
+		if (f >= max - dis) f = max - dis;
 
 		f = (f - min) / (max - min);
 
 		return int(f*_gn);
 	}
 
-	inline Ind Spatial::decode(int en) const
+	inline Ind Spatial::decode(uint64_t en) const
 	{
-		Ind ci;
-		// Note: k_max_gn implied here.
-		ci[2] = en&((1 << 10) - 1);
-		en = en >> 10;
-		ci[1] = en&((1 << 10) - 1);
-		en = en >> 10;
-		ci[0] = en;
-		return ci;
+		uint32_t x, y, z; mortonDecode(en, x, y, z);
+		return Ind(float(x), float(y), float(z));
+	}
+
+	template<typename ScanCell> void Spatial::scan_rings(const glm::vec3& p, const float& bestdis2, ScanCell scan_cell, bool exact) const
+	{
+		float epsfactor = exact ? 1.f : _epsfactor;
+		int ci[3]; for_int(c, 3) { ci[c] = float_to_index_clamped(c, p[c]); }
+		auto consider = [&](int i, int j, int k)
+		{
+			float gap2 = square(cell_gap(0, i, p[0])) + square(cell_gap(1, j, p[1])) + square(cell_gap(2, k, p[2]));
+			if (gap2 * epsfactor <= bestdis2) scan_cell(i, j, k);
+		};
+		for (int r = 0; ; r++)
+		{
+			if (r > 0)
+			{
+				float ringgap = BIGFLOAT; // every cell of the ring is at ci[c] - r or ci[c] + r on some axis
+				for_int(c, 3)
+				{
+					if (ci[c] - r >= _cellmin[c]) ringgap = std::min(ringgap, cell_gap(c, ci[c] - r, p[c]));
+					if (ci[c] + r <= _cellmax[c]) ringgap = std::min(ringgap, cell_gap(c, ci[c] + r, p[c]));
+				}
+				if (ringgap == BIGFLOAT || square(ringgap) * epsfactor > bestdis2) return; // grid exhausted, or nearest found
+			}
+			int lo[3], hi[3];
+			for_int(c, 3) { lo[c] = std::max(ci[c] - r, _cellmin[c]); hi[c] = std::min(ci[c] + r, _cellmax[c]); }
+			for (int i = lo[0]; i <= hi[0]; i++) for (int j = lo[1]; j <= hi[1]; j++)
+			{
+				if (std::abs(i - ci[0]) < r && std::abs(j - ci[1]) < r)
+				{
+					if (ci[2] - r >= _cellmin[2]) consider(i, j, ci[2] - r);
+					if (ci[2] + r <= _cellmax[2]) consider(i, j, ci[2] + r);
+					continue;
+				}
+				for (int k = lo[2]; k <= hi[2]; k++) consider(i, j, k);
+			}
+		}
 	}
 
 	class PointSpatial : public BPointSpatial
@@ -149,6 +271,120 @@ namespace HuguesHoppe
 		void remove(int id, const glm::vec3* pp) { BPointSpatial::remove(id, pp); }
 	};
 
+	// Static spatial data structure for a fixed set of points, built once in parallel.
+	// Points are bucketed by cell with a counting sort into contiguous arrays (ids and copied coordinates),
+	// and a dense table gives the range of each cell, so add_cell() is a table lookup and a SIMD scan.
+	// Within a cell the points keep their index order, as if entered into a PointSpatial in order.
+	// Finer grids, whose dense table would outgrow the points, keep the ranges of the nonempty cells only, found
+	// by binary search among their sorted Morton keys; the points are then bucketed by a sort instead.
+	class GridPointSpatial : public Spatial
+	{
+	public:
+		// Up to this grid size the cell table is dense, _gn^3+1 offsets, and so are the cell counts of the build,
+		// 1 MB for each chunk of at least 64K points.
+		static constexpr int k_max_dense_gn = 64;
+		static constexpr int k_scan_block = 64;    // points of a cell per kernel call
+		GridPointSpatial(int gn, const Vec2<glm::vec3>& boxBound, int n, const glm::vec3* points);
+		void clear() override;
+		size_t memory_usage() const override;
+		int radius_search(const glm::vec3& p, float radius, std::vector<int>& ids, std::vector<float>* dis2, int maxcount) const override;
+		int nearest(const glm::vec3& p, float* dis2 = nullptr) const override;
+	private:
+		void add_cell(const Ind& ci, SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound& bound) const override;
+		int pq_id(const Node& pqe) const override;
+		size_t cell_index(int i, int j, int k) const { return (size_t(i) * _gn + j) * _gn + k; } // in the dense table
+		void cell_range(int i, int j, int k, int& b, int& e) const; // cell (i, j, k) holds elements [b, e)
+		bool _dense;
+		std::vector<int> _cellstart;       // table entry c holds elements [_cellstart[c], _cellstart[c+1])
+		std::vector<uint64_t> _cellkeys;   // sparse table: Morton keys of the nonempty cells, sorted, one per entry
+		std::vector<int> _ids;             // element ids, grouped by cell
+		std::vector<float> _x, _y, _z;     // element coordinates, grouped by cell
+	};
+
+	// Static kd-tree over a fixed set of points, for clouds whose density varies too much for a uniform grid.
+	// The tree is balanced by count and stored implicitly (children of node i are 2i+1 and 2i+2), with all leaves
+	// on the last level. Each leaf holds at most k_leaf_size points as a padded block of x, y and z arrays.
+	// The grid has a single cell: add_cell() enters the root, and pq_refine() opens tree nodes in order of
+	// their box distance, scanning whole leaf blocks at once, until the nearest entry is a point.
+	class KdPointSpatial : public Spatial
+	{
+	public:
+		static constexpr int k_leaf_size = 16;
+		KdPointSpatial(const Vec2<glm::vec3>& boxBound, int n, const glm::vec3* points);
+		void clear() override;
+		size_t memory_usage() const override;
+		int radius_search(const glm::vec3& p, float radius, std::vector<int>& ids, std::vector<float>* dis2, int maxcount) const override;
+		int nearest(const glm::vec3& p, float* dis2 = nullptr) const override;
+	private:
+		void add_cell(const Ind& ci, SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound& bound) const override;
+		void pq_refine(SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound& bound) const override;
+		int pq_id(const Node& pqe) const override;
+		float box_dis2(int node, const glm::vec3& p) const;
+		int _depth{ 0 };                   // level of the leaves
+		std::vector<Vec2<glm::vec3>> _box; // bounding box of the points of each node
+		std::vector<int> _count;           // number of points of each leaf
+		std::vector<float> _x, _y, _z;     // leaf blocks of k_leaf_size coordinates, padded
+		std::vector<int> _ids;             // element ids of the leaf blocks, -1 for padding
+	};
+
+	// Spatial data structure for a changing set of points, e.g. streamed in by a live capture and culled as it goes.
+	// Like GridPointSpatial, a dense table maps each cell to its points, packed into id, x, y and z arrays (coordinates
+	// copied); grids finer than GridPointSpatial::k_max_dense_gn use a hash table keyed by Morton code instead.
+	// Each id records its cell and slot, so remove() moves the last point of the cell into the hole in O(1).
+	// Emptied cells are kept for reuse until they outnumber the others, when compact() drops them and trims the arrays
+	// that are mostly unused. Ids index a table, so they should be small nonnegative integers.
+	// Points outside the box go to the boundary cells. The searches keep to the range of cells that have held points
+	// since the last compaction (_cellmin, _cellmax), so a sparse fine grid is not walked beyond its points.
+	class DynamicPointSpatial : public Spatial
+	{
+	public:
+		DynamicPointSpatial(int gn, const Vec2<glm::vec3>& boxBound);
+		void clear() override;
+		size_t memory_usage() const override;
+		void enter(int id, const glm::vec3& p);                     // id must not be present
+		void enter(int n, const int* ids, const glm::vec3* points); // bulk insert, each cell grown once
+		void remove(int id);                                        // must exist, else die
+		bool contains(int id) const { return id >= 0 && id < int(_loc.size()) && _loc[id].slot >= 0; }
+		int size() const { return _size; }
+		void compact();
+		int radius_search(const glm::vec3& p, float radius, std::vector<int>& ids, std::vector<float>* dis2, int maxcount) const override;
+		int nearest(const glm::vec3& p, float* dis2 = nullptr) const override;
+	private:
+		struct Cell
+		{
+			uint64_t key; // in the cell table
+			std::vector<int> ids;
+			std::vector<float> x, y, z;
+		};
+		struct Location
+		{
+			int cell;       // index in _cells
+			int slot{ -1 }; // index in the cell, -1 if not present
+		};
+		void add_cell(const Ind& ci, SPriority_Queue& pq, const glm::vec3& pcenter, SearchBound& bound) const override;
+		int pq_id(const Node& pqe) const override;
+		// Key of cell (i, j, k):  its index in the dense table, else its Morton code
+		uint64_t cell_key(int i, int j, int k) const
+		{
+			return _dense ? (uint64_t(i) * _gn + j) * _gn + k : mortonEncode(uint32_t(i), uint32_t(j), uint32_t(k));
+		}
+		uint64_t point_cell(const glm::vec3& p) const;
+		int cell_slot(uint64_t key) const; // index in _cells, -1 if none
+		void set_cell_slot(uint64_t key, int slot);
+		const Cell* find_cell(uint64_t key) const { int slot = cell_slot(key); return slot < 0 ? nullptr : &_cells[slot]; }
+		int cell_for_insert(uint64_t key, int nadd); // returns the index in _cells
+		void append(int slot, int id, const glm::vec3& p);
+		void clear_extent();              // no cells in the search range
+		void extend(const glm::vec3& p); // add the cell of p to the search range
+		bool _dense;
+		std::vector<int> _cellslot;  // dense table:  cell key -> index in _cells, -1 if none
+		std::unordered_map<uint64_t, int> _cellmap; // hash table:  cell key -> index in _cells
+		std::vector<Cell> _cells;    // cells that have held points since the last compaction
+		std::vector<Location> _loc;  // id -> location of its point
+		int _size{ 0 };
+		int _nempty{ 0 };            // cells of _cells without points
+	};
+
 	class SpatialSearch : public BSpatialSearch
 	{
 	public:
@@ -203,6 +439,22 @@ namespace HuguesHoppe
 		return CoordL_range<D>(uL, uU);
 	}
 
+	template<typename ScanCell> void Spatial::scan_radius(const glm::vec3& p, float radius, int maxcount, ScanCell scan_cell) const
+	{
+		if (maxcount <= k_outward_maxcount)
+		{
+			float bound = square(radius); // made negative to stop
+			scan_rings(p, bound, [&](int i, int j, int k) { if (!scan_cell(i, j, k)) bound = -1.f; }, true);
+			return;
+		}
+		Ind ci0, ci1; box_to_indices(p - glm::vec3(radius), p + glm::vec3(radius), ci0, ci1);
+		for_int(c, 3) { ci0[c] = float(std::max(int(ci0[c]), _cellmin[c])); ci1[c] = float(std::min(int(ci1[c]), _cellmax[c])); }
+		for (const Ind& ci : coordsL<3>(ci0, ci1 + Ind(1.f)))
+		{
+			if (!scan_cell(int(ci[0]), int(ci[1]), int(ci[2]))) return;
+		}
+	}
+
 } // namespace HuguesHoppe
 
 #endif // SPATIAL_H
@@ -0,0 +1,162 @@
+#include "SpatialKernels.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define SPATIAL_KERNELS_X86
+# define SPATIAL_TARGET(isa) __attribute__((target(isa)))
+# include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+# define SPATIAL_KERNELS_X86
+# define SPATIAL_TARGET(isa)
+# include <immintrin.h>
+# include <intrin.h>
+#endif
+
+// No fused multiply-adds in this file, so the kernels agree exactly (see SpatialKernels.hpp). The Makefile also
+// builds it with -Mnofma; the pragmas cover the other compilers, which may contract when FMA is enabled.
+#if defined(__clang__)
+# pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+# pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+# pragma fp_contract(off)
+#endif
+
+namespace HuguesHoppe
+{
+	namespace
+	{
+#if defined(_MSC_VER)
+		inline int lowest_bit(unsigned mask) { unsigned long i; _BitScanForward(&i, mask); return int(i); }
+		inline int bit_count(unsigned mask) { return int(__popcnt(mask)); }
+#else
+		inline int lowest_bit(unsigned mask) { return __builtin_ctz(mask); }
+		inline int bit_count(unsigned mask) { return __builtin_popcount(mask); }
+#endif
+
+		int select_within_scalar(const float* x, const float* y, const float* z, int i, int n, const glm::vec3& p,
+			float bound2, int* sel, float* dis2, int count)
+		{
+			for (; i < n; i++)
+			{
+				float dx = x[i] - p[0], dy = y[i] - p[1], dz = z[i] - p[2];
+				float d2 = dx * dx + dy * dy + dz * dz;
+				if (d2 > bound2) continue;
+				sel[count] = i;
+				dis2[count++] = d2;
+			}
+			return count;
+		}
+
+#if defined(SPATIAL_KERNELS_X86)
+		SPATIAL_TARGET("avx2")
+		int select_within_avx2(const float* x, const float* y, const float* z, int n, const glm::vec3& p,
+			float bound2, int* sel, float* dis2)
+		{
+			const __m256 px = _mm256_set1_ps(p[0]), py = _mm256_set1_ps(p[1]), pz = _mm256_set1_ps(p[2]);
+			const __m256 bound = _mm256_set1_ps(bound2);
+			int count = 0, i = 0;
+			for (; i + 8 <= n; i += 8)
+			{
+				__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), px);
+				__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), py);
+				__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), pz);
+				__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+				unsigned mask = unsigned(_mm256_movemask_ps(_mm256_cmp_ps(d2, bound, _CMP_LE_OQ)));
+				if (!mask) continue;
+				alignas(32) float lanes[8];
+				_mm256_store_ps(lanes, d2);
+				for (; mask; mask &= mask - 1)
+				{
+					int lane = lowest_bit(mask);
+					sel[count] = i + lane;
+					dis2[count++] = lanes[lane];
+				}
+			}
+			return select_within_scalar(x, y, z, i, n, p, bound2, sel, dis2, count);
+		}
+
+		SPATIAL_TARGET("avx512f")
+		int select_within_avx512(const float* x, const float* y, const float* z, int n, const glm::vec3& p,
+			float bound2, int* sel, float* dis2)
+		{
+			const __m512 px = _mm512_set1_ps(p[0]), py = _mm512_set1_ps(p[1]), pz = _mm512_set1_ps(p[2]);
+			const __m512 bound = _mm512_set1_ps(bound2);
+			const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+			int count = 0, i = 0;
+			for (; i < n; i += 16)
+			{
+				// The last block loads only the remaining lanes
+				__mmask16 valid = n - i >= 16 ? __mmask16(0xffff) : __mmask16((1u << (n - i)) - 1);
+				__m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(valid, x + i), px);
+				__m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(valid, y + i), py);
+				__m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(valid, z + i), pz);
+				// The explicitly rounded forms are not fused into multiply-adds (avx512f implies fma); their zero-masked
+				// forms, unlike the unmasked ones, define every lane, which keeps gcc's uninitialized warnings quiet
+				const int rounding = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+				__m512 d2 = _mm512_maskz_add_round_ps(valid,
+					_mm512_maskz_add_round_ps(valid, _mm512_maskz_mul_round_ps(valid, dx, dx, rounding), _mm512_maskz_mul_round_ps(valid, dy, dy, rounding), rounding),
+					_mm512_maskz_mul_round_ps(valid, dz, dz, rounding), rounding);
+				__mmask16 mask = _mm512_mask_cmp_ps_mask(valid, d2, bound, _CMP_LE_OQ);
+				if (!mask) continue;
+				_mm512_mask_compressstoreu_epi32(sel + count, mask, _mm512_add_epi32(lane, _mm512_set1_epi32(i)));
+				_mm512_mask_compressstoreu_ps(dis2 + count, mask, d2);
+				count += bit_count(mask);
+			}
+			return count;
+		}
+
+		SpatialKernel detect_kernel()
+		{
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) return KERNEL_SCALAR;
+			__cpuid(info, 1);
+			bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+			if (!osxsave || !avx) return KERNEL_SCALAR;
+			unsigned long long xcr0 = _xgetbv(0);
+			__cpuidex(info, 7, 0);
+			if ((xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16))) return KERNEL_AVX512;
+			if ((xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5))) return KERNEL_AVX2;
+			return KERNEL_SCALAR;
+#else
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx512f")) return KERNEL_AVX512;
+			if (__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+			return KERNEL_SCALAR;
+#endif
+		}
+#else
+		SpatialKernel detect_kernel() { return KERNEL_SCALAR; }
+#endif
+	} // namespace
+
+	SpatialKernel spatial_kernel()
+	{
+		static const SpatialKernel kernel = detect_kernel();
+		return kernel;
+	}
+
+	const char* spatial_kernel_name(SpatialKernel kernel)
+	{
+		return kernel == KERNEL_AVX512 ? "avx512" : kernel == KERNEL_AVX2 ? "avx2" : "scalar";
+	}
+
+	int select_within(SpatialKernel kernel, const float* x, const float* y, const float* z, int n, const glm::vec3& p,
+		float bound2, int* sel, float* dis2)
+	{
+		assert(kernel <= spatial_kernel());
+#if defined(SPATIAL_KERNELS_X86)
+		if (kernel == KERNEL_AVX512) return select_within_avx512(x, y, z, n, p, bound2, sel, dis2);
+		if (kernel == KERNEL_AVX2) return select_within_avx2(x, y, z, n, p, bound2, sel, dis2);
+#endif
+		return select_within_scalar(x, y, z, 0, n, p, bound2, sel, dis2, 0);
+	}
+
+	int select_within(const float* x, const float* y, const float* z, int n, const glm::vec3& p, float bound2,
+		int* sel, float* dis2)
+	{
+		return select_within(spatial_kernel(), x, y, z, n, p, bound2, sel, dis2);
+	}
+
+} // namespace HuguesHoppe
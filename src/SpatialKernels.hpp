@@ -0,0 +1,29 @@
+#ifndef SPATIAL_KERNELS_H
+#define SPATIAL_KERNELS_H
+
+#include "includes/includes.hpp"
+
+namespace HuguesHoppe
+{
+	// Squared distance kernels for the spatial cell and leaf scans, over points stored as separate x, y, z arrays.
+	// The widest kernel the cpu supports is picked at run time: AVX-512 (16 lanes), AVX2 (8 lanes) or scalar.
+	// All kernels compute dx*dx + dy*dy + dz*dz in that order without fused multiply-adds, so they agree exactly;
+	// SpatialKernels.cpp turns floating point contraction off for this.
+
+	enum SpatialKernel { KERNEL_SCALAR, KERNEL_AVX2, KERNEL_AVX512 };
+
+	// Widest kernel supported by the cpu (and the compiler), detected once.
+	SpatialKernel spatial_kernel();
+	const char* spatial_kernel_name(SpatialKernel kernel);
+
+	// The points i < n within squared distance bound2 of p: their indices in sel[] and squared distances in dis2[],
+	// in index order. sel and dis2 need room for n entries. Returns the number of points selected.
+	int select_within(const float* x, const float* y, const float* z, int n, const glm::vec3& p, float bound2,
+		int* sel, float* dis2);
+	// Same with a given kernel, which must be supported (for tests and benchmarks).
+	int select_within(SpatialKernel kernel, const float* x, const float* y, const float* z, int n, const glm::vec3& p,
+		float bound2, int* sel, float* dis2);
+
+} // namespace HuguesHoppe
+
+#endif // SPATIAL_KERNELS_H
@@ -13,6 +13,10 @@ update speed, toggle axes, and toggle idle function.
 
 #include "includes/includes.hpp"
 
+// Built with HEADLESS_ONLY the program only runs batch reconstructions and needs no GL headers or libraries
+#ifndef HEADLESS_ONLY
+#include "includes/includesGL.hpp"
+
 // Initial gl includes required before wglext.h/glxext.h include
 #ifdef _WIN32
 #include <Windows.h>
@@ -41,10 +45,10 @@ PFNWGLSWAPINTERVALEXTPROC wglSwapIntervalEXT = NULL;
 #include "Scene.hpp"
 #include "DynamicCamera.hpp"
 #include "StaticEntity.hpp"
-#include "Spatial.hpp"
-#include "Graph.hpp"
-#include "Principal.hpp"
-#include "Contour.hpp"
+#endif
+#include "PointCloud.hpp"
+#include "Reconstruction.hpp"
+#include "MeshIO.hpp"
 using namespace HuguesHoppe;
 
 // constants for models:  file names, vertex count, model display size
@@ -52,8 +56,14 @@ const int nModels = 4;  // number of models in this scene
 char * modelFile[nModels] = { "src/sphere1k.pcd" };
 char * vertexShaderFile = "src/simpleVertex.glsl";
 char * fragmentShaderFile = "src/simpleFragment.glsl";
+char * meshFile = NULL; // Reconstructed mesh output (.ply or .obj), not saved if NULL
+bool headless = false; // Batch reconstruction without window or GL context
+char * statsFile = NULL; // JSON report of timers and counters, not saved if NULL
 
+PointCloud* pointCloud;  // The loaded point cloud
+bool useFileNormals = true; // Use oriented normals from the point cloud file instead of estimating them
 
+#ifndef HEADLESS_ONLY
 // Shader handles, matrices, etc
 GLuint shaderProgram;
 GLuint MVP, NormalMatrix, ModelView;  // Model View Projection matrix's handle
@@ -61,22 +71,8 @@ GLuint VAO[nModels], buffer[nModels];
 GLuint vao;
 
 // Point cloud information
-PointCloud* pointCloud;  // The loaded point cloud
 StaticEntity* pc;
-Vec2<glm::vec3> pcBoxBound;
-int numVertices, numContourVertices; // number of vertices/points
-std::vector<glm::vec3> points; // The point cloud points
-std::vector<glm::vec3> pcTPOrig; // Origins of Tangent Planes
-std::vector<glm::mat4x3> pcTP; // Tangent planes
-std::vector<glm::vec3> pcTPNorm; // Normals of Tangen Planes
-std::vector<bool> pcTPOrient; // Is tangent plane oriented
-std::unique_ptr<PointSpatial> SPp; // Point spatial partition
-std::unique_ptr<PointSpatial> SPpc; // pcTPOrig spatial partition
-std::unique_ptr<Graph<int>> gpcpseudo; // Riemannian on pc centers (based on co)
-std::unique_ptr<Graph<int>> gpcpath; // path of orientation propagation
-Mesh mesh;
-int minkintp = 4, maxkintp = 20, gridsize = 10; // Min/Max number of points in tangent plane
-float samplingDensity = 0.0f; // Sampling density
+int numContourVertices; // number of contour vertices
 bool showPointCloud = true, showUnorientTP = false, showOrientTP = false,
 showContour = false, cullFace = true;
 
@@ -233,224 +229,6 @@ void update(int value)
 	}
 }
 
-// Compute the tangent plane
-void compute_tp(int i, int& n, glm::mat4x3& f)
-{
-	std::vector<glm::vec3> pointArray;
-	SpatialSearch ss(*SPp, points[i]);
-	for (;;) {
-		assert(!ss.done());
-		float distanceSquared; int pointId = ss.next(&distanceSquared);
-		if ((int(pointArray.size()) <= minkintp && distanceSquared > square(samplingDensity)) || int(pointArray.size()) >= maxkintp) break;
-		pointArray.push_back(points[pointId]);
-		if (pointId != i && !gpcpseudo->contains(i, pointId)) gpcpseudo->enter_undirected(i, pointId);
-	}
-	glm::vec3 eimag;
-	principal_components(pointArray, f, eimag);
-	n = pointArray.size();
-}
-
-// Compute tangent planes for all points
-void process_principal()
-{
-	for_int(i, numVertices)
-	{
-		int n;
-		glm::mat4x3 f = glm::mat4x3();
-		compute_tp(i, n, f);
-		pcTP[i] = f;
-		pcTPOrig[i] = f[3];
-		pcTPNorm[i] = glm::normalize(f[2]);
-	}
-}
-
-float pc_corr(int i, int j)
-{
-	if (j == numVertices && i < numVertices) return pc_corr(j, i);
-	assert(i >= 0 && j >= 0 && i <= numVertices && j < numVertices);
-	float vdot, corr;
-
-	if (i == numVertices)
-	{
-		vdot = 1.f;     // single exterior link
-	}
-	else
-	{
-		vdot = glm::dot(pcTPNorm[i], pcTPNorm[j]);
-	}
-	corr = 2.f - std::abs(vdot);
-
-	return corr;
-}
-
-// Compute the dot product between two tangent planes
-float pc_dot(int i, int j)
-{
-	assert(i >= 0 && j >= 0 && i <= numVertices && j < numVertices);
-	if (i == numVertices)
-	{
-		return pcTPNorm[j][2] < 0.f ? -1.f : 1.f;
-	}
-	else
-	{
-		return glm::dot(pcTPNorm[i], pcTPNorm[j]);
-	}
-}
-
-// Propagate orientation along tree gpcpath from vertex i (orig. num) using recursive DFS.
-void propagate_along_path(int i)
-{
-	assert(i >= 0 && i <= numVertices);
-	if (i < numVertices) assert(pcTPOrient[i]);
-	for (int j : gpcpath->edges(i))
-	{
-		assert(j >= 0 && j <= numVertices);
-		if (j == numVertices || pcTPOrient[j]) continue; // immediate caller
-		float corr = pc_dot(i, j);
-		if (corr<0) pcTPNorm[j] = -pcTPNorm[j];
-		pcTPOrient[j] = true;
-		propagate_along_path(j);
-	}
-}
-
-void add_exterior_orientation(const std::set<int>& nodes)
-{
-	// vertex num is a pseudo-node used for outside orientation
-	gpcpseudo->enter(numVertices);
-
-	// add 1 pseudo-edge to point with largest z value
-	float maxz = -BIGFLOAT;
-	int maxi = -1;
-
-	for (int i : nodes)
-	{
-		if (pcTPOrig[i][2] > maxz) { maxz = pcTPOrig[i][2]; maxi = i; }
-	}
-
-	gpcpseudo->enter_undirected(maxi, numVertices);
-}
-
-void remove_exterior_orientation()
-{
-	std::vector<int> ari = std::vector<int>();
-	for (int j : gpcpseudo->edges(numVertices)) { ari.push_back(j); }
-	for (int i : ari) { gpcpseudo->remove_undirected(numVertices, i); }
-	gpcpseudo->remove(numVertices);
-}
-
-// Orient the set of tangent planes (orient surface normals)
-void orient_set(const std::set<int>& nodes)
-{
-	printf("component with %d points\n", nodes.size());
-	add_exterior_orientation(nodes);
-	gpcpath = std::make_unique<Graph<int>>();
-	for (int i : nodes) { gpcpath->enter(i); }
-	gpcpath->enter(numVertices);
-	{
-		// must be connected here!
-		assert(graph_mst<int>(*gpcpseudo, pc_corr, *gpcpath));
-	}
-	int nextlink = gpcpath->out_degree(numVertices);
-	if (nextlink>1) printf(" num_exteriorlinks_used=%d\n", nextlink);
-	propagate_along_path(numVertices);
-	gpcpath.reset();
-	remove_exterior_orientation();
-}
-
-// Orient each tangent plane, by considering neighbors
-void orient_tp()
-{
-	// Now treat each connected component of gpcpseudo separately.
-	std::set<int> setnotvis = std::set<int>();
-	for_int(i, numVertices) { setnotvis.insert(i); }
-
-	while (!setnotvis.empty())
-	{
-		std::set<int> nodes = std::set<int>();
-		std::queue<int> queue = std::queue<int>();
-		int fi = *(setnotvis.begin());
-		nodes.insert(fi);
-		queue.push(fi);
-
-		while (!queue.empty())
-		{
-			int i = queue.front();
-			queue.pop();
-			assert(setnotvis.erase(i));
-
-			for (int j : gpcpseudo->edges(i))
-			{
-				if (nodes.insert(j).second) queue.push(j);
-			}
-		}
-
-		orient_set(nodes);
-	}
-
-	for_int(i, numVertices) { assert(pcTPOrient[i]); }
-}
-
-// Find the closest tangent plane origin and compute the signed distance to that tangent plane.
-// Was: check to see if the projection onto the tangent plane lies farther than samplingDensity from any data point.
-// Now: check to see if the sample point is farther than samplingDensity+cube_size from any data point.
-float compute_signed(const glm::vec3& p, glm::vec3& proj)
-{
-	SpatialSearch ss1(*SPpc, p);
-	int tpi = ss1.next();
-	glm::vec3 vptopc = p - pcTPOrig[tpi];
-	float dis = glm::dot(vptopc, pcTPNorm[tpi]);
-	proj = p - dis * pcTPNorm[tpi];
-
-	// Check that projected point is in point cloud space
-	for_int(i, 3)
-	{
-		float min = pcBoxBound[0][i], max = pcBoxBound[1][i];
-		float dis = 0.1f;
-		if (proj[i] < pcBoxBound[0][i] - dis || proj[i] > pcBoxBound[1][i] + dis)
-			return k_Contour_undefined;
-	}
-
-	// check that projected point is close to a data point
-	SpatialSearch ss2(*SPp, proj);
-	float dis2; ss2.next(&dis2);
-	if (dis2>square(samplingDensity))
-		return k_Contour_undefined;
-
-	// check that grid point is close to a data point
-	SpatialSearch ss3(*SPp, p);
-	float dis3; ss3.next(&dis3);
-	float xDis = pcBoxBound[1][0] - pcBoxBound[0][0];
-	float yDis = pcBoxBound[1][1] - pcBoxBound[0][1];
-	float zDis = pcBoxBound[1][2] - pcBoxBound[0][2];
-	float grid_diagonal2 = square(xDis / gridsize) + square(yDis / gridsize) + square(zDis / gridsize);
-	const float fudge = 1.2f;
-
-	// This may be required
-	//if (dis3>grid_diagonal2*square(fudge))
-	//	return k_Contour_undefined;
-
-	return dis;
-}
-
-struct eval_point
-{
-	float operator()(const glm::vec3& pp) const
-	{
-		glm::vec3 p = pp;
-		glm::vec3 proj;
-		float dis = compute_signed(p, proj);
-		if (dis == k_Contour_undefined) return dis;
-		return dis;
-	}
-};
-
-template<typename Contour> void contour_3D(Contour& contour)
-{
-	for_int(i, numVertices) {
-		contour.march_from(pcTPOrig[i]);
-	}
-}
-
 // Creates the tangent planes for rendering
 void makeTangentPlanes(GLuint vao, GLuint vbo)
 {
@@ -524,8 +302,7 @@ void makeTangentPlanes(GLuint vao, GLuint vbo)
 
 void makeContour(GLuint vao, GLuint vbo)
 {
-	std::vector<Face> faces = mesh.facesVector();
-	numContourVertices = faces.size() * 3;
+	numContourVertices = mesh.num_faces() * 3;
 	int vec3Size = numContourVertices * sizeof(glm::vec3);
 	int vec4Size = numContourVertices * sizeof(glm::vec4);
 	glm::vec4* vertex = (glm::vec4 *) calloc(vec4Size, sizeof(glm::vec4));
@@ -534,7 +311,7 @@ void makeContour(GLuint vao, GLuint vbo)
 
 	int index = 0;
 
-	for (Face face : faces)
+	for (Face face : mesh.faces())
 	{
 		HEdge he = face->herep;
 		HEdge start = he;
@@ -572,15 +349,6 @@ void makeContour(GLuint vao, GLuint vbo)
 	free(normal);
 }
 
-glm::vec3 sphereToCartesian(float rho, float theta, float phi)
-{
-	glm::vec3 point = glm::vec3();
-	point.x = rho * sin(phi) * cos(theta);
-	point.y = rho * sin(phi) * sin(theta);
-	point.z = rho * cos(phi);
-	return point;
-}
-
 std::string getName(const char* fileName)
 {
 	std::string file = fileName;
@@ -588,156 +356,106 @@ std::string getName(const char* fileName)
 	size_t f2 = file.find_last_of('.');
 	return file.substr(f1 + 1, f2 - f1 - 1);
 }
-
-bool writeTimes(float tpTime, float orientTime, float contourTime)
-{
-	FILE* fileOut;
-	fileOut = fopen("times.txt", "a");
-	std::string model = getName(pointCloud->File());
-
-	if (fileOut != NULL)
-	{
-		fprintf(fileOut, "%s false %d %d %f %f %f\n", model.c_str(), numVertices, gridsize, tpTime, orientTime, contourTime);
-		fclose(fileOut);
-		return true;
-	}
-
-	return false;
-}
+#endif
 
 // load the shader programs, vertex data from model files, create the solids, set initial view
-void init()
+// In headless mode only the reconstruction runs, nothing touches GLUT, GLEW or GL.
+bool init()
 {
-	// Create random sphere point cloud
-	if (false)
 	{
-		std::vector<glm::vec3> points = std::vector<glm::vec3>();
-		srand((unsigned int)time(NULL));
-		int numPoints = 100000;
-		float rho = 1.0f;
-
-		for_int(i, numPoints)
+		ScopedTimer timer("load");
+		if (headless)
 		{
-			float theta = 2 * PI * ((float)rand() / RAND_MAX);//random range is 0.0 to 1.0
-			float phi = acos(2.0f * ((float)rand() / RAND_MAX) - 1.0f);
-			glm::vec3 point = sphereToCartesian(rho, theta, phi);
-			points.push_back(point);
+			// Only positions and bounds, no GL context
+			pointCloud = new PointCloud(modelFile[0]);
 		}
+#ifndef HEADLESS_ONLY
+		else
+		{
+			// load the shader programs
+			shaderProgram = loadShaders(vertexShaderFile, fragmentShaderFile);
+			glUseProgram(shaderProgram);
 
-		writePointCloud("src/sphere100k.pcd", numPoints, points);
-	}
-
-	if (false)
-	{
-		std::vector<glm::vec3> points = std::vector<glm::vec3>();
-		srand((unsigned int)time(NULL));
-		int numPoints = 1000000;
+			// generate VAOs and VBOs
+			glGenVertexArrays(nModels, VAO);
+			glGenBuffers(nModels, buffer);
 
-		for_int(i, numPoints)
-		{
-			glm::vec2 planar = glm::vec2((float)rand() / RAND_MAX * 2.0f - 1.0f, (float)rand() / RAND_MAX * 2.0f - 1.0f);
-			int side = rand() % 6;
-			glm::vec3 point = glm::vec3();
-			switch (side)
+			// Load models
+			for (int i = 0; i < 1; i++)
 			{
-			case 0:
-				point = glm::vec3(planar.x, planar.y, -1);
-				break;
-			case 1:
-				point = glm::vec3(planar.x, planar.y, 1);
-				break;
-			case 2:
-				point = glm::vec3(planar.x, -1, planar.y);
-				break;
-			case 3:
-				point = glm::vec3(planar.x, 1, planar.y);
-				break;
-			case 4:
-				point = glm::vec3(-1, planar.x, planar.y);
-				break;
-			case 5:
-				point = glm::vec3(1, planar.x, planar.y);
-				break;
+				pointCloud = new PointCloud(modelFile[i], &VAO[i], &buffer[i], &shaderProgram);
+				if (pointCloud->Vertices() > 0)
+				{
+					bufferPointCloud(VAO[i], buffer[i], shaderProgram, pointCloud->PointData(), pointCloud->Vertices());
+				}
+				scene->AddPointCloud(pointCloud);
 			}
-			points.push_back(point);
 		}
-
-		writePointCloud("src/cube1m.pcd", numPoints, points);
+#endif
 	}
 
-	// load the shader programs
-	shaderProgram = loadShaders(vertexShaderFile, fragmentShaderFile);
-	glUseProgram(shaderProgram);
-
-	// generate VAOs and VBOs
-	glGenVertexArrays(nModels, VAO);
-	glGenBuffers(nModels, buffer);
-
-	// Load models
-	for (int i = 0; i < 1; i++)
+	numVertices = pointCloud->Vertices();
+	if (numVertices <= 0)
 	{
-		pointCloud = new PointCloud(modelFile[i], &VAO[i], &buffer[i], &shaderProgram);
+		printf("init error:  no points loaded from %s\n", modelFile[0]);
+		return false;
 	}
 
-	pc = new StaticEntity(scene->GetModel(getName(pointCloud->File())));
+	recordMemory("load", reconstruction_memory());
 
-	numVertices = pointCloud->Vertices();
-	radius = pc->BoundingRadius() * 2.1f;
-	setUniform("radiusOffset", radius - pc->BoundingRadius());
-	samplingDensity = INFINITY;
+	// Initialize tangent plane arrays and spatial partition
+	setup_reconstruction(numVertices, pointCloud->PointData(), Vec2<glm::vec3>(pointCloud->MinBound(), pointCloud->MaxBound()));
+	recordMemory("setup", reconstruction_memory());
 	printf("Sampling Density %3f\n", samplingDensity);
-
-	sprintf(pointClousdStr, "  Point Cloud %s", pointCloud->File());
-	sprintf(verticesStr, "  Vertices %i", numVertices);
-
-	// Initialize tangent plane arrays
-	pcTPOrig = std::vector<glm::vec3>(numVertices);
-	pcTPNorm = std::vector<glm::vec3>(numVertices);
-	pcTPOrient = std::vector<bool>(numVertices, false);
-	pcTP = std::vector<glm::mat4x3>(numVertices);
-	pcBoxBound = Vec2<glm::vec3>(pointCloud->MinBound(), pointCloud->MaxBound());
 	showVec3("Min", pcBoxBound[0]);
 	showVec3("Max", pcBoxBound[1]);
 
-	// Create spatial partition
-	int n = numVertices > 100000 ? 60 : numVertices > 5000 ? 36 : 20;
-	SPp = std::make_unique<PointSpatial>(n, pcBoxBound);
-	points = *(pointCloud->Points());
-	for_int(i, numVertices) { SPp->enter(i, &points[i]); } // Adds all points to spatial partition
-
-	gpcpseudo = std::make_unique<Graph<int>>();
-	for_int(i, numVertices) { gpcpseudo->enter(i); } // Add point index to graph
+	// Oriented normals from the file make tangent plane estimation and orientation unnecessary
+	const glm::vec3* normals = useFileNormals ? pointCloud->NormalData() : NULL;
+	if (normals != NULL)
+	{
+		printf("Using normals from %s, skipping tangent plane estimation and orientation\n", pointCloud->File());
+	}
 
-	double time = glutGet(GLUT_ELAPSED_TIME);
-	process_principal(); // Compute the tangent planes
-	double end = glutGet(GLUT_ELAPSED_TIME);
-	double tpTime = end - time;
-	printf("Process Principal: %3f\n", (tpTime / 1000));
+	compute_tangent_planes(normals);
+	recordMemory("tangent_planes", reconstruction_memory());
 
+#ifndef HEADLESS_ONLY
 	// Create unoriented tangent planes
-	makeTangentPlanes(VAO[1], buffer[1]);
-
-	SPpc = std::make_unique<PointSpatial>(n, pcBoxBound);
-	for_int(i, numVertices) { SPpc->enter(i, &pcTPOrig[i]); } // Add tp origins to spatial partition
+	if (!headless) makeTangentPlanes(VAO[1], buffer[1]);
+#endif
 
-	time = glutGet(GLUT_ELAPSED_TIME);
-	orient_tp(); // Orient tangent planes
-	end = glutGet(GLUT_ELAPSED_TIME);
-	double orientTime = end - time;
-	printf("Orient Tangent Planes: %3f\n", (orientTime / 1000));
-	gpcpseudo.reset();
+	orient_tangent_planes();
+	recordMemory("orientation", reconstruction_memory());
 
+#ifndef HEADLESS_ONLY
 	// Create oriented tangent planes
-	makeTangentPlanes(VAO[2], buffer[2]);
+	if (!headless) makeTangentPlanes(VAO[2], buffer[2]);
+#endif
 
-	time = glutGet(GLUT_ELAPSED_TIME);
-	Contour3DMesh<eval_point> contour(gridsize, pcBoxBound, &mesh);
-	contour_3D(contour);
-	end = glutGet(GLUT_ELAPSED_TIME);
-	double contourTime = end - time;
-	printf("Contour: %3f\n", (contourTime / 1000));
+	contour_tangent_planes();
+	recordMemory("contour", reconstruction_memory());
 
-	writeTimes(tpTime, orientTime, contourTime);
+	if (meshFile != NULL)
+	{
+		ScopedTimer timer("write_mesh");
+		if (!write_mesh(mesh, meshFile)) return false;
+	}
+
+	printStats();
+	if (statsFile != NULL) writeStats(statsFile);
+
+#ifdef HEADLESS_ONLY
+	return true;
+#else
+	if (headless) return true;
+
+	pc = new StaticEntity(scene->GetModel(getName(pointCloud->File())));
+	radius = pc->BoundingRadius() * 2.1f;
+	setUniform("radiusOffset", radius - pc->BoundingRadius());
+
+	sprintf(pointClousdStr, "  Point Cloud %s", pointCloud->File());
+	sprintf(verticesStr, "  Vertices %i", numVertices);
 
 	// Create oriented tangent planes
 	makeContour(VAO[3], buffer[3]);
@@ -766,8 +484,11 @@ void init()
 
 	// Finalize scene
 	scene->InitDone();
+	return true;
+#endif
 }
 
+#ifndef HEADLESS_ONLY
 // Keyboard input
 void keyboard(unsigned char key, int x, int y)
 {
@@ -949,8 +670,143 @@ void mouseMove(int x, int y)
 	}
 }
 
+#endif
+
+void usage(const char* program)
+{
+#ifndef HEADLESS_ONLY
+	printf("usage:  %s                               interactive viewer of %s\n", program, modelFile[0]);
+#else
+	printf("usage:\n");
+#endif
+	printf("        %s model gridsize [mesh]         headless reconstruction\n", program);
+	printf("        %s -i model [options]            headless reconstruction\n", program);
+	printf("        %s -convert model.pcd model.pcb  convert to binary point cloud\n", program);
+	printf("        %s -generate shape count model.pcb [-seed n] [-noise sigma] [-nonuniform] [-normals] [-t n]\n", program);
+	printf("                                         synthetic point cloud, shape is sphere, cube, torus or knot\n");
+	printf("options:\n");
+	printf("  -i file             input point cloud (.pcd, .pcb or .ply)\n");
+	printf("  -o file             output mesh (.ply or .obj)\n");
+	printf("  -g n                grid size of the contouring (%d)\n", gridsize);
+	printf("  -kmin n             minimum points in a tangent plane (%d)\n", minkintp);
+	printf("  -kmax n             maximum points in a tangent plane (%d)\n", maxkintp);
+	printf("  -t n                worker threads (%d)\n", threadCount());
+	printf("  -spatial name       nearest point index, grid or kdtree (%s)\n", spatialIndexName(spatialIndex));
+	printf("  -morton             reorder the points along a Morton curve for locality\n");
+	printf("  -eps x              approximate nearest searches, up to 1+x times farther (%g)\n", searchEpsilon);
+	printf("  -cache dir          reuse the oriented tangent planes cached in dir\n");
+	printf("  -estimate-normals   ignore normals in the input file\n");
+	printf("  -stats file         JSON report of stage timers and counters\n");
+#ifndef HEADLESS_ONLY
+	printf("  -gui                show the result in a window instead of exiting\n");
+#endif
+}
+
+// Parse the command line, returns false on bad arguments
+bool parseArguments(int argc, char* argv[])
+{
+#ifdef HEADLESS_ONLY
+	headless = true;
+	if (argc < 2) return false; // no viewer to fall back to
+#else
+	headless = argc > 1;
+#endif
+	int positional = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(arg, "-i") == 0 && hasValue) modelFile[0] = argv[++i];
+		else if (strcmp(arg, "-o") == 0 && hasValue) meshFile = argv[++i];
+		else if (strcmp(arg, "-g") == 0 && hasValue) gridsize = atoi(argv[++i]);
+		else if (strcmp(arg, "-kmin") == 0 && hasValue) minkintp = atoi(argv[++i]);
+		else if (strcmp(arg, "-kmax") == 0 && hasValue) maxkintp = atoi(argv[++i]);
+		else if (strcmp(arg, "-t") == 0 && hasValue) setThreadCount(atoi(argv[++i]));
+		else if (strcmp(arg, "-spatial") == 0 && hasValue) spatialIndex = spatialIndexFromName(argv[++i]);
+		else if (strcmp(arg, "-morton") == 0) mortonOrder = true;
+		else if (strcmp(arg, "-eps") == 0 && hasValue) searchEpsilon = float(atof(argv[++i]));
+		else if (strcmp(arg, "-cache") == 0 && hasValue) tangentPlaneCacheDir = argv[++i];
+		else if (strcmp(arg, "-estimate-normals") == 0) useFileNormals = false;
+		else if (strcmp(arg, "-stats") == 0 && hasValue) statsFile = argv[++i];
+#ifndef HEADLESS_ONLY
+		else if (strcmp(arg, "-gui") == 0) headless = false;
+#endif
+		else if (arg[0] != '-' && positional < 3)
+		{
+			// Legacy form:  model gridsize [mesh]
+			if (positional == 0) modelFile[0] = argv[i];
+			else if (positional == 1) gridsize = atoi(arg);
+			else meshFile = argv[i];
+			positional++;
+		}
+		else
+		{
+			printf("unknown or incomplete argument %s\n", arg);
+			return false;
+		}
+	}
+
+	if (gridsize < 1 || minkintp < 1 || maxkintp < minkintp || spatialIndex == SPATIAL_INVALID || !(searchEpsilon >= 0.f))
+	{
+		printf("invalid arguments:  gridsize %d, kmin %d, kmax %d, spatial %s, eps %g\n", gridsize, minkintp, maxkintp,
+			spatialIndexName(spatialIndex), searchEpsilon);
+		return false;
+	}
+	return true;
+}
+
 int main(int argc, char* argv[])
 {
+	// Convert a *.pcd text file to a *.pcb binary file, no window needed
+	if (argc > 3 && strcmp(argv[1], "-convert") == 0)
+	{
+		return convertPointCloud(argv[2], argv[3]) ? 0 : 1;
+	}
+
+	// Generate a synthetic *.pcb point cloud, no window needed
+	if (argc > 1 && strcmp(argv[1], "-generate") == 0)
+	{
+		GeneratorSettings settings = { SHAPE_INVALID, 0, 1, 0.0f, false, false };
+		bool valid = argc > 4;
+		if (valid)
+		{
+			settings.shape = pointCloudShape(argv[2]);
+			settings.count = atoi(argv[3]);
+		}
+		for (int i = 5; i < argc && valid; i++)
+		{
+			bool hasValue = i + 1 < argc;
+			if (strcmp(argv[i], "-seed") == 0 && hasValue) settings.seed = strtoull(argv[++i], NULL, 10);
+			else if (strcmp(argv[i], "-noise") == 0 && hasValue) settings.noise = (float)atof(argv[++i]);
+			else if (strcmp(argv[i], "-nonuniform") == 0) settings.nonUniform = true;
+			else if (strcmp(argv[i], "-normals") == 0) settings.normals = true;
+			else if (strcmp(argv[i], "-t") == 0 && hasValue) setThreadCount(atoi(argv[++i]));
+			else valid = false;
+		}
+		if (!valid || settings.shape == SHAPE_INVALID || settings.count <= 0)
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		return generatePointCloud(argv[4], settings) ? 0 : 1;
+	}
+
+	if (!parseArguments(argc, argv))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	// Batch reconstruction, nothing below touches GLUT, GLEW or GL
+	if (headless)
+	{
+		bool ok = init();
+		printf(ok ? "done\n" : "failed\n");
+		delete pointCloud;
+		return ok ? 0 : 1;
+	}
+
+#ifndef HEADLESS_ONLY
 	glutInit(&argc, argv);
 # ifdef __Mac__
 	// Can't change the version in the GLUT_3_2_CORE_PROFILE
@@ -992,29 +848,25 @@ int main(int argc, char* argv[])
 	printf("LINUX\n");
 #endif
 
-	if (argc > 1)
-	{
-		modelFile[0] = argv[1];
-		gridsize = atoi(argv[2]);
-	}
-
 	// initialize scene
-	init();
-	// set glut callback functions
-	if (argc <= 1)
+	if (!init())
 	{
-		glutDisplayFunc(display);
-		glutReshapeFunc(reshape);
-		glutKeyboardFunc(keyboard);
-		glutMouseFunc(mouseState);
-		glutMotionFunc(mouseMove);
-		glutSpecialFunc(specialKeys);
-		glutSpecialUpFunc(specialUpFunc);
-		glutTimerFunc(scene->TimerDelay(), update, 1);
-		glutIdleFunc(display);
-		glutMainLoop();
+		delete scene;
+		return 1;
 	}
+	// set glut callback functions
+	glutDisplayFunc(display);
+	glutReshapeFunc(reshape);
+	glutKeyboardFunc(keyboard);
+	glutMouseFunc(mouseState);
+	glutMotionFunc(mouseMove);
+	glutSpecialFunc(specialKeys);
+	glutSpecialUpFunc(specialUpFunc);
+	glutTimerFunc(scene->TimerDelay(), update, 1);
+	glutIdleFunc(display);
+	glutMainLoop();
 	printf("done\n");
 	delete scene;
 	return 0;
+#endif
 }
@@ -15,8 +15,9 @@ __MAC__        // Mac OSX
 __MinGW__      // Windows, Minimalist Gnu for Windows
 __Windows__    // Windows, Visual Studio 201?)
 
-Includes utility functions to load glsl shaders and
-AC3D *.tri models.
+Includes utility functions to load point clouds.  Nothing here needs
+OpenGL:  the GL, GLEW and freeglut headers and the shader loader are in
+includesGL.hpp, which only the viewer sources include.
 
 Mike Barnes
 8/25/2016
@@ -29,8 +30,6 @@ Mike Barnes
 # define GLM_FORCE_ONLY_XYZW
 # define GLM_FORCE_PURE  // for latest version of GLM w/ error C2719: ,,,  __declspec(align('16')) won't be aligned
 # define GLM_FORCE_CXX98
-# define BUFFER_OFFSET(x)  ((const GLvoid *) (x))  // OpenGL PG 8th ed. code, in vgl.h 
-# define MAX_INFO_LOG_SIZE 2048  // for error messages in loadShaders(...)
 
 #pragma warning(disable: 4996)
 
@@ -55,9 +54,6 @@ Mike Barnes
 # include <memory>
 # include "HuguesHoppe.hpp"
 
-# include <GL/glew.h>
-# include <GL/freeglut.h>
-
 // include the glm shader-like math library
 # define GLM_FORCE_RADIANS  // use radians not angles
 # define GLM_MESSAGES   // compiler messages
@@ -68,8 +64,17 @@ Mike Barnes
 # include <glm/gtx/quaternion.hpp>
 # include <glm/gtc/random.hpp>
 # include "glmUtils.hpp"  // print matrices and vectors, ... 
-# include "shader.hpp"    // load vertex and fragment shaders
+# include "mappedFile.hpp"  // read-only file mapping
+# include "memory.hpp"      // resident set size, container bytes
+# include "timer.hpp"       // wall clock timing
+# include "stats.hpp"       // scoped timers and counters
+# include "parallel.hpp"    // thread helpers
+# include "morton.hpp"      // 64-bit Morton keys of grid indices
 # include "pointCloudLoader.hpp"  // load AC3D *.tri model 
+# include "pointCloudBinary.hpp"  // load / write *.pcb binary point clouds
+# include "tangentPlaneCache.hpp"  // cached oriented tangent planes (*.tpc)
+# include "pointCloudGenerator.hpp"  // synthetic *.pcb point clouds
+# include "plyLoader.hpp"  // load binary *.ply point clouds with normals
 
 // PI to 10 digits
 const float PI = glm::pi<float>();
@@ -0,0 +1,53 @@
+/*
+includesGL.hpp
+
+The viewer's OpenGL headers on top of includes.hpp:  GLEW, freeglut, the
+glsl shader loader and the upload of point clouds into vertex buffers.
+
+Only the sources that draw or run the GLUT loop include this, so the
+reconstruction and the benchmark compile without the GL headers and link
+without the GL libraries (see the headless targets of the Makefile).
+*/
+
+#ifndef __INCLUDES_GL__
+#define __INCLUDES_GL__
+
+#include "includes.hpp"
+
+# define BUFFER_OFFSET(x)  ((const GLvoid *) (x))  // OpenGL PG 8th ed. code, in vgl.h 
+# define MAX_INFO_LOG_SIZE 2048  // for error messages in loadShaders(...)
+
+# include <GL/glew.h>
+# include <GL/freeglut.h>
+
+# include "shader.hpp"    // load vertex and fragment shaders
+
+// Fill the point cloud's buffer straight from packed positions (e.g. a mapped *.pcb file).
+// Color and normal are constant, so they are set as generic attributes instead of arrays.
+inline void bufferPointCloud(GLuint vao, GLuint vbo, GLuint shaderProgram,
+	const glm::vec3* points, int nVertices)
+{
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, nVertices * sizeof(glm::vec3), points, GL_STATIC_DRAW);
+	// set vertex shader variable handles, vPosition.w defaults to 1
+	GLint vPosition = glGetAttribLocation(shaderProgram, "vPosition");
+	glEnableVertexAttribArray(vPosition);
+	glVertexAttribPointer(vPosition, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+	GLint vColor = glGetAttribLocation(shaderProgram, "vColor");
+	if (vColor >= 0)
+	{
+		glDisableVertexAttribArray(vColor);
+		glVertexAttrib4f(vColor, 1.0f, 1.0f, 1.0f, 1.0f);
+	}
+	GLint vNormal = glGetAttribLocation(shaderProgram, "vNormal");
+	if (vNormal >= 0)
+	{
+		glDisableVertexAttribArray(vNormal);
+		glVertexAttrib3f(vNormal, 0.0f, 0.0f, 1.0f);
+	}
+
+	printf("vPosition %d, vColor %d, vNormal %d \n", vPosition, vColor, vNormal);
+}
+
+#endif
@@ -0,0 +1,86 @@
+/*
+mappedFile.hpp
+
+Read-only memory mapping of a whole file.
+
+The file contents are available through Data() for as long as the
+MappedFile object lives, so pointers into the mapping must not outlive it.
+Pages are only read from disk when they are first touched, opening a large
+file is therefore (almost) free.
+
+Uses mmap on Linux / Mac and CreateFileMapping on Windows.
+*/
+
+#ifndef __MAPPED_FILE__
+#define __MAPPED_FILE__
+
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <Windows.h>
+#else
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+class MappedFile : HuguesHoppe::noncopyable
+{
+private:
+	const char* m_pData; // Start of the mapping, NULL if not open
+	size_t m_iSize; // Size of the file in bytes
+#ifdef _WIN32
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+#endif
+
+public:
+	explicit MappedFile(const char* fileName) :
+		m_pData(NULL),
+		m_iSize(0)
+	{
+#ifdef _WIN32
+		m_hMapping = NULL;
+		m_hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (m_hFile == INVALID_HANDLE_VALUE) return;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0) return;
+		m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_hMapping == NULL) return;
+		m_pData = (const char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+		if (m_pData != NULL) m_iSize = (size_t)size.QuadPart;
+#else
+		int fd = open(fileName, O_RDONLY);
+		if (fd < 0) return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED)
+			{
+				m_pData = (const char*)data;
+				m_iSize = (size_t)st.st_size;
+			}
+		}
+		close(fd); // the mapping keeps its own reference to the file
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (m_pData != NULL) UnmapViewOfFile(m_pData);
+		if (m_hMapping != NULL) CloseHandle(m_hMapping);
+		if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+#else
+		if (m_pData != NULL) munmap((void*)m_pData, m_iSize);
+#endif
+	}
+
+	bool IsOpen() const { return m_pData != NULL; }
+	const char* Data() const { return m_pData; }
+	size_t Size() const { return m_iSize; }
+};
+
+#endif
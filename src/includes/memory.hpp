@@ -0,0 +1,82 @@
+/*
+memory.hpp
+
+Process memory and estimates of the bytes held by standard containers.
+
+peakResidentBytes() is the peak resident set size of the process,
+currentResidentBytes() the current one, 0 where it can't be read.
+
+vectorBytes(v) and hashBytes(c) estimate the heap bytes of a std::vector
+and of a std::unordered_map/set:  the bucket array plus one node per
+element (the value, the next pointer, the cached hash and the allocator
+header).  They do not include the heap bytes owned by the elements.
+heapObjectBytes is the allocator header added to every new'ed object.
+*/
+
+#ifndef __MEMORY__
+#define __MEMORY__
+
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <Windows.h>
+# include <psapi.h>
+# pragma comment(lib, "psapi.lib")
+#else
+# include <sys/resource.h>
+# include <unistd.h>
+#endif
+
+inline size_t peakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+# ifdef __APPLE__
+	return (size_t)usage.ru_maxrss; // bytes
+# else
+	return (size_t)usage.ru_maxrss * 1024; // kilobytes
+# endif
+#endif
+}
+
+inline size_t currentResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.WorkingSetSize;
+#else
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (file == NULL) return 0;
+	long pages = 0, resident = 0;
+	int n = fscanf(file, "%ld %ld", &pages, &resident);
+	fclose(file);
+	return n == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+const size_t heapObjectBytes = 2 * sizeof(void*);
+
+template<typename T> size_t vectorBytes(const std::vector<T>& v)
+{
+	return v.capacity() * sizeof(T);
+}
+
+inline size_t vectorBytes(const std::vector<bool>& v)
+{
+	return v.capacity() / 8;
+}
+
+template<typename C> size_t hashBytes(const C& c)
+{
+	return c.bucket_count() * sizeof(void*) +
+		c.size() * (sizeof(typename C::value_type) + sizeof(void*) + sizeof(size_t) + heapObjectBytes);
+}
+
+#endif
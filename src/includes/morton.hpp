@@ -0,0 +1,58 @@
+/*
+morton.hpp
+
+64-bit Morton (Z-order) keys of 3D grid indices.
+
+The bits of the three indices are interleaved, x in the highest bit of
+each triple, so keys of nearby cells share their high bits and sorting by
+key walks the grid in spatially coherent order.  Each index has
+mortonBits = 21 bits, grids up to 2^21 cells per axis.
+
+mortonEncode(x, y, z) returns the key of the indices, mortonDecode(key,
+x, y, z) recovers them.
+*/
+
+#ifndef __MORTON__
+#define __MORTON__
+
+#include <stdint.h>
+
+const int mortonBits = 21; // bits per index
+
+// Spread the low 21 bits of v to every third bit
+inline uint64_t mortonSpread(uint64_t v)
+{
+	v &= 0x1fffff;
+	v = (v | v << 32) & 0x001f00000000ffffull;
+	v = (v | v << 16) & 0x001f0000ff0000ffull;
+	v = (v | v << 8) & 0x100f00f00f00f00full;
+	v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+	v = (v | v << 2) & 0x1249249249249249ull;
+	return v;
+}
+
+// Gather every third bit of v into the low 21 bits, inverse of mortonSpread
+inline uint32_t mortonCompact(uint64_t v)
+{
+	v &= 0x1249249249249249ull;
+	v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3ull;
+	v = (v ^ (v >> 4)) & 0x100f00f00f00f00full;
+	v = (v ^ (v >> 8)) & 0x001f0000ff0000ffull;
+	v = (v ^ (v >> 16)) & 0x001f00000000ffffull;
+	v = (v ^ (v >> 32)) & 0x1fffff;
+	return (uint32_t)v;
+}
+
+inline uint64_t mortonEncode(uint32_t x, uint32_t y, uint32_t z)
+{
+	return mortonSpread(x) << 2 | mortonSpread(y) << 1 | mortonSpread(z);
+}
+
+inline void mortonDecode(uint64_t key, uint32_t& x, uint32_t& y, uint32_t& z)
+{
+	x = mortonCompact(key >> 2);
+	y = mortonCompact(key >> 1);
+	z = mortonCompact(key);
+}
+
+#endif
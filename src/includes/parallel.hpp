@@ -0,0 +1,170 @@
+/*
+parallel.hpp
+
+Minimal thread helpers built on std::thread.
+
+threadCount() is the number of worker threads used by parallelFor(...),
+hardware concurrency unless changed with setThreadCount(...).
+
+parallelFor(nTasks, func) calls func(task) for task in [0, nTasks) on
+threadCount() threads.  Tasks are handed out one at a time from a shared
+counter, so uneven tasks still balance.  Returns when all tasks are done.
+The calling thread works too, with threadCount() - 1 workers started on the
+first call that needs them and kept for the later ones, so a loop costs a
+wakeup instead of thread creation; their thread_local state (e.g. search
+storage) persists across loops.  Workers flush their LocalStatCounter
+counts before a loop returns.  A parallelFor(...) nested in another one, or
+called while one runs on another thread, runs on the calling thread alone.
+
+parallelSort(v, less) sorts the vector v like std::sort(..., less):  chunks
+are sorted in parallel, then merged pairwise in parallel rounds.  Elements
+that compare equal may end up in any order.
+*/
+
+#ifndef __PARALLEL__
+#define __PARALLEL__
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <vector>
+
+inline int& threadCountSetting()
+{
+	static int count = 0; // 0 means hardware concurrency
+	return count;
+}
+
+inline void setThreadCount(int count)
+{
+	threadCountSetting() = count > 0 ? count : 0;
+}
+
+inline int threadCount()
+{
+	if (threadCountSetting() > 0) return threadCountSetting();
+	int count = (int)std::thread::hardware_concurrency();
+	return count > 0 ? count : 1;
+}
+
+// Workers of parallelFor(...), kept for the life of the process
+class ParallelWorkers
+{
+public:
+	// The workers, never destroyed:  they wait for loops until the process exits
+	static ParallelWorkers& instance()
+	{
+		static ParallelWorkers* workers = new ParallelWorkers();
+		return *workers;
+	}
+
+	// True on a worker, and on a thread running a loop
+	static bool& inLoop()
+	{
+		static thread_local bool busy = false;
+		return busy;
+	}
+
+	// Call func(task) for task in [0, nTasks) on the calling thread and nWorkers workers;
+	// false, doing nothing, if a loop is running
+	template<typename Func> bool run(int nTasks, int nWorkers, Func& func)
+	{
+		std::unique_lock<std::mutex> running(m_runMutex, std::try_to_lock);
+		if (!running.owns_lock()) return false;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			while ((int)m_threads.size() < nWorkers)
+			{
+				int index = (int)m_threads.size();
+				m_threads.emplace_back([this, index]() { work(index); });
+			}
+			m_call = [](void* f, int task) { (*(Func*)f)(task); };
+			m_func = &func;
+			m_nTasks = nTasks;
+			m_next = 0;
+			m_nWorkers = nWorkers;
+			m_pending = nWorkers;
+			m_loop++;
+		}
+		m_start.notify_all();
+		inLoop() = true;
+		runTasks();
+		inLoop() = false;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_pending == 0; });
+		return true;
+	}
+
+private:
+	std::mutex m_runMutex; // held by the thread running a loop
+	std::mutex m_mutex;    // guards the loop description and m_pending
+	std::condition_variable m_start, m_done;
+	std::vector<std::thread> m_threads;
+	void (*m_call)(void*, int) = NULL;
+	void* m_func = NULL;
+	int m_nTasks = 0;
+	std::atomic<int> m_next{ 0 };
+	int m_nWorkers = 0; // workers [0, m_nWorkers) take part in the loop
+	int m_pending = 0;  // of them, those not done yet
+	uint64_t m_loop = 0;
+
+	void runTasks()
+	{
+		for (int task = m_next++; task < m_nTasks; task = m_next++) m_call(m_func, task);
+	}
+
+	void work(int index)
+	{
+		inLoop() = true;
+		uint64_t seen = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_start.wait(lock, [&]() { return m_loop != seen; });
+				seen = m_loop;
+				if (index >= m_nWorkers) continue;
+			}
+			runTasks();
+			flushStats();
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_pending == 0) m_done.notify_one();
+		}
+	}
+};
+
+template<typename Func> void parallelFor(int nTasks, Func func)
+{
+	int nThreads = std::min(threadCount(), nTasks);
+	if (nThreads <= 1 || ParallelWorkers::inLoop() || !ParallelWorkers::instance().run(nTasks, nThreads - 1, func))
+	{
+		for (int task = 0; task < nTasks; task++) func(task);
+	}
+}
+
+template<typename T, typename Less> void parallelSort(std::vector<T>& v, Less less)
+{
+	const size_t minChunkSize = 1 << 14;
+	int nChunks = (int)std::min<size_t>(v.size() / minChunkSize + 1, (size_t)threadCount());
+	std::vector<size_t> bound(nChunks + 1);
+	for (int i = 0; i <= nChunks; i++) bound[i] = v.size() * i / nChunks;
+	parallelFor(nChunks, [&](int i) { std::sort(v.begin() + bound[i], v.begin() + bound[i + 1], less); });
+
+	std::vector<T> merged(v.size());
+	for (int width = 1; width < nChunks; width *= 2)
+	{
+		// Merge chunk runs [i, i + width) and [i + width, i + 2 width), copy a lone last run
+		int nPairs = (nChunks + 2 * width - 1) / (2 * width);
+		parallelFor(nPairs, [&](int pair)
+		{
+			int first = pair * 2 * width;
+			size_t b = bound[first], m = bound[std::min(first + width, nChunks)], e = bound[std::min(first + 2 * width, nChunks)];
+			std::merge(v.begin() + b, v.begin() + m, v.begin() + m, v.begin() + e, merged.begin() + b, less);
+		});
+		v.swap(merged);
+	}
+}
+
+#endif
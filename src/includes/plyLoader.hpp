@@ -0,0 +1,289 @@
+/*
+plyLoader.hpp
+
+Reader for binary little-endian PLY point clouds, as written by most scanners.
+
+readPointCloudPly(...) reads the x, y, z properties of the "vertex" element
+and, when the file has them, the nx, ny, nz properties as normals.  Any
+scalar property type is accepted and converted to float; list properties
+are only allowed on elements other than "vertex" and are skipped.  The
+vertex records are converted on all threads straight from the mapped file.
+
+Returns the bounding radius, -1.0f on error.  normals is left empty when the
+file has no normals.
+*/
+
+#ifndef __PLY_LOADER__
+#define __PLY_LOADER__
+
+enum PlyType { PLY_INVALID, PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64 };
+
+struct PlyProperty
+{
+	std::string name;
+	PlyType type;
+	PlyType listCountType; // PLY_INVALID unless this is a list property
+};
+
+struct PlyElement
+{
+	std::string name;
+	int count;
+	std::vector<PlyProperty> properties;
+};
+
+inline PlyType plyType(const std::string& name)
+{
+	if (name == "char" || name == "int8") return PLY_INT8;
+	if (name == "uchar" || name == "uint8") return PLY_UINT8;
+	if (name == "short" || name == "int16") return PLY_INT16;
+	if (name == "ushort" || name == "uint16") return PLY_UINT16;
+	if (name == "int" || name == "int32") return PLY_INT32;
+	if (name == "uint" || name == "uint32") return PLY_UINT32;
+	if (name == "float" || name == "float32") return PLY_FLOAT32;
+	if (name == "double" || name == "float64") return PLY_FLOAT64;
+	return PLY_INVALID;
+}
+
+inline int plyTypeSize(PlyType type)
+{
+	switch (type)
+	{
+	case PLY_INT8: case PLY_UINT8: return 1;
+	case PLY_INT16: case PLY_UINT16: return 2;
+	case PLY_INT32: case PLY_UINT32: case PLY_FLOAT32: return 4;
+	case PLY_FLOAT64: return 8;
+	default: return 0;
+	}
+}
+
+// Value of a little-endian scalar (host is assumed little-endian)
+inline double plyValue(const char* p, PlyType type)
+{
+	switch (type)
+	{
+	case PLY_INT8: { int8_t v; memcpy(&v, p, 1); return v; }
+	case PLY_UINT8: { uint8_t v; memcpy(&v, p, 1); return v; }
+	case PLY_INT16: { int16_t v; memcpy(&v, p, 2); return v; }
+	case PLY_UINT16: { uint16_t v; memcpy(&v, p, 2); return v; }
+	case PLY_INT32: { int32_t v; memcpy(&v, p, 4); return v; }
+	case PLY_UINT32: { uint32_t v; memcpy(&v, p, 4); return v; }
+	case PLY_FLOAT32: { float v; memcpy(&v, p, 4); return v; }
+	case PLY_FLOAT64: { double v; memcpy(&v, p, 8); return v; }
+	default: return 0.0;
+	}
+}
+
+inline bool isPly(const MappedFile& file)
+{
+	return file.IsOpen() && file.Size() >= 4 && memcmp(file.Data(), "ply", 3) == 0 &&
+		(file.Data()[3] == '\n' || file.Data()[3] == '\r');
+}
+
+inline float readPointCloudPly(const MappedFile& file, const char* fileName,
+	std::vector<glm::vec3>* points, std::vector<glm::vec3>* normals, glm::vec3& min, glm::vec3& max)
+{
+	if (!isPly(file))
+	{
+		printf("readPointCloudPly error:  %s is not a ply file\n", fileName);
+		return -1.0f;
+	}
+
+	// Parse the header
+	const char* p = file.Data();
+	const char* end = p + file.Size();
+	std::vector<PlyElement> elements;
+	bool binaryLE = false, headerDone = false;
+	while (p < end && !headerDone)
+	{
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		if (eol == NULL) break;
+		std::string line(p, eol);
+		p = eol + 1;
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+
+		char word[3][64];
+		int count = 0;
+		int nWords = sscanf(line.c_str(), "%63s %63s %63s", word[0], word[1], word[2]);
+		if (nWords <= 0) continue;
+		std::string keyword = word[0];
+		if (keyword == "format")
+		{
+			binaryLE = nWords >= 2 && strcmp(word[1], "binary_little_endian") == 0;
+		}
+		else if (keyword == "element" && nWords == 3 && sscanf(word[2], "%d", &count) == 1)
+		{
+			if (count < 0)
+			{
+				printf("readPointCloudPly error:  negative count of element %s in %s\n", word[1], fileName);
+				return -1.0f;
+			}
+			elements.push_back(PlyElement{ word[1], count, std::vector<PlyProperty>() });
+		}
+		else if (keyword == "property" && !elements.empty())
+		{
+			char listCount[64], listItem[64], name[64];
+			if (nWords >= 2 && strcmp(word[1], "list") == 0 &&
+				sscanf(line.c_str(), "%*s %*s %63s %63s %63s", listCount, listItem, name) == 3)
+			{
+				// the count must be an integer type, else the list is rejected as of unknown type
+				PlyType countType = plyType(listCount);
+				bool integer = countType != PLY_INVALID && countType != PLY_FLOAT32 && countType != PLY_FLOAT64;
+				elements.back().properties.push_back(PlyProperty{ name, integer ? plyType(listItem) : PLY_INVALID,
+					integer ? countType : PLY_UINT8 });
+			}
+			else if (nWords == 3)
+			{
+				elements.back().properties.push_back(PlyProperty{ word[2], plyType(word[1]), PLY_INVALID });
+			}
+		}
+		else if (keyword == "end_header")
+		{
+			headerDone = true;
+		}
+	}
+
+	if (!headerDone || !binaryLE)
+	{
+		printf("readPointCloudPly error:  %s is not a binary_little_endian ply file\n", fileName);
+		return -1.0f;
+	}
+
+	// Skip the elements in front of "vertex"
+	const PlyElement* vertex = NULL;
+	for (const PlyElement& element : elements)
+	{
+		for (const PlyProperty& property : element.properties)
+		{
+			if (property.type == PLY_INVALID)
+			{
+				printf("readPointCloudPly error:  unknown type of property %s in %s\n", property.name.c_str(), fileName);
+				return -1.0f;
+			}
+		}
+		if (element.name == "vertex") { vertex = &element; break; }
+		for (int i = 0; i < element.count; i++)
+		{
+			for (const PlyProperty& property : element.properties)
+			{
+				double n = 1.0;
+				if (property.listCountType != PLY_INVALID)
+				{
+					size_t countSize = plyTypeSize(property.listCountType);
+					if ((size_t)(end - p) < countSize) n = -1.0;
+					else { n = plyValue(p, property.listCountType); p += countSize; }
+				}
+				// a negative count, or more items than bytes left, means the data can't be followed
+				size_t itemSize = plyTypeSize(property.type);
+				if (!(n >= 0.0) || n > double(end - p) / itemSize)
+				{
+					printf("readPointCloudPly error:  bad list count or truncated element %s in %s\n",
+						element.name.c_str(), fileName);
+					return -1.0f;
+				}
+				p += (size_t)n * itemSize;
+			}
+		}
+	}
+
+	if (vertex == NULL)
+	{
+		printf("readPointCloudPly error:  no vertex element in %s\n", fileName);
+		return -1.0f;
+	}
+
+	// Offsets of x, y, z, nx, ny, nz in a vertex record
+	const char* names[6] = { "x", "y", "z", "nx", "ny", "nz" };
+	int offsets[6] = { -1, -1, -1, -1, -1, -1 };
+	PlyType types[6] = { PLY_INVALID, PLY_INVALID, PLY_INVALID, PLY_INVALID, PLY_INVALID, PLY_INVALID };
+	int stride = 0;
+	for (const PlyProperty& property : vertex->properties)
+	{
+		if (property.listCountType != PLY_INVALID)
+		{
+			printf("readPointCloudPly error:  list property %s on vertex in %s\n", property.name.c_str(), fileName);
+			return -1.0f;
+		}
+		for_int(i, 6)
+		{
+			if (property.name == names[i]) { offsets[i] = stride; types[i] = property.type; }
+		}
+		stride += plyTypeSize(property.type);
+	}
+
+	if (offsets[0] < 0 || offsets[1] < 0 || offsets[2] < 0)
+	{
+		printf("readPointCloudPly error:  vertex without x, y, z in %s\n", fileName);
+		return -1.0f;
+	}
+	bool hasNormals = offsets[3] >= 0 && offsets[4] >= 0 && offsets[5] >= 0;
+
+	int nVertices = vertex->count;
+	if (p > end || (size_t)(end - p) < (size_t)nVertices * stride)
+	{
+		printf("readPointCloudPly error:  count of vertices mismatch in %s\n", fileName);
+		return -1.0f;
+	}
+
+	// Convert the vertex records in blocks on all threads
+	points->resize(nVertices);
+	if (hasNormals) normals->resize(nVertices); else normals->clear();
+	const char* records = p;
+	const int blockSize = 1 << 16;
+	int nBlocks = (nVertices + blockSize - 1) / blockSize;
+	std::vector<glm::vec3> blockMin(nBlocks, glm::vec3(float(INT_MAX))), blockMax(nBlocks, glm::vec3(float(INT_MIN)));
+	std::vector<float> blockRadius(nBlocks, -1.0f);
+	parallelFor(nBlocks, [&](int block)
+	{
+		glm::vec3 bMin = blockMin[block], bMax = blockMax[block];
+		float bRadius = -1.0f;
+		int last = std::min(nVertices, (block + 1) * blockSize);
+		for (int i = block * blockSize; i < last; i++)
+		{
+			const char* record = records + (size_t)i * stride;
+			glm::vec3 point;
+			for_int(c, 3) { point[c] = (float)plyValue(record + offsets[c], types[c]); }
+			(*points)[i] = point;
+			if (hasNormals)
+			{
+				glm::vec3 normal;
+				for_int(c, 3) { normal[c] = (float)plyValue(record + offsets[3 + c], types[3 + c]); }
+				(*normals)[i] = normal;
+			}
+			for_int(c, 3)
+			{
+				if (bRadius < std::abs(point[c])) bRadius = std::abs(point[c]);
+				if (bMin[c] > point[c]) bMin[c] = point[c];
+				if (bMax[c] < point[c]) bMax[c] = point[c];
+			}
+		}
+		blockMin[block] = bMin;
+		blockMax[block] = bMax;
+		blockRadius[block] = bRadius;
+	});
+
+	min = glm::vec3(float(INT_MAX));
+	max = glm::vec3(float(INT_MIN));
+	float boundingRadius = -1.0f;
+	for (int block = 0; block < nBlocks; block++)
+	{
+		for_int(c, 3)
+		{
+			if (min[c] > blockMin[block][c]) min[c] = blockMin[block][c];
+			if (max[c] < blockMax[block][c]) max[c] = blockMax[block][c];
+		}
+		if (boundingRadius < blockRadius[block]) boundingRadius = blockRadius[block];
+	}
+
+	if (boundingRadius == -1.0f)
+	{
+		printf("readPointCloudPly error:  returned -1.0f \n");
+		return -1.0f;
+	}
+
+	printf("loaded %s model with %7.2f bounding radius and %d vertices%s\n", fileName, boundingRadius, nVertices,
+		hasNormals ? " with normals" : "");
+	return boundingRadius;
+}
+
+#endif
@@ -0,0 +1,154 @@
+/*
+pointCloudBinary.hpp
+
+Binary point cloud format (*.pcb), meant to be memory mapped with MappedFile
+and used in place, without parsing or copying.
+
+Layout, all values little-endian:
+	PointCloudBinaryHeader  (64 bytes)
+	count x float32[3]      positions, packed
+	count x float32[3]      normals, only if PCB_NORMALS is set
+
+The header carries the bounds and bounding radius so nothing has to be
+scanned on load.  Extra attributes are stored as separate arrays after the
+positions so the positions stay packed and can be handed to OpenGL as is.
+
+isPointCloudBinary(...) tells a *.pcb file, valid or not, by its magic or name.
+readPointCloudBinary(...) validates a mapped file and returns its header.
+pointCloudBinaryHeader(...) fills in a header, for writers that stream.
+writePointCloudBinary(...) writes points (and optional normals) to a file.
+convertPointCloud(...) converts a *.pcd text file to a *.pcb file.
+*/
+
+#ifndef __POINT_CLOUD_BINARY__
+#define __POINT_CLOUD_BINARY__
+
+#include <stdint.h>
+
+const char PCB_MAGIC[4] = { 'P', 'C', 'B', '1' };
+
+// Flags for PointCloudBinaryHeader::attributes
+enum PointCloudBinaryAttribute
+{
+	PCB_NORMALS = 1 << 0 // float32[3] normal per point
+};
+
+struct PointCloudBinaryHeader
+{
+	char magic[4]; // PCB_MAGIC
+	uint32_t headerSize; // offset of the position array
+	uint64_t count; // number of points
+	uint32_t attributes; // PointCloudBinaryAttribute flags
+	float boundingRadius; // maximum absolute coordinate
+	float min[3]; // minimum bound coordinate
+	float max[3]; // maximum bound coordinate
+	uint32_t reserved[4];
+};
+
+static_assert(sizeof(PointCloudBinaryHeader) == 64, "PointCloudBinaryHeader must be 64 bytes");
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be packed");
+
+// True if the mapped file fileName starts with PCB_MAGIC or is named *.pcb, so it is to be read as a *.pcb file
+inline bool isPointCloudBinary(const MappedFile& file, const char* fileName)
+{
+	if (file.IsOpen() && file.Size() >= sizeof(PCB_MAGIC) && memcmp(file.Data(), PCB_MAGIC, sizeof(PCB_MAGIC)) == 0) return true;
+	size_t length = strlen(fileName);
+	return length >= 4 && strcmp(fileName + length - 4, ".pcb") == 0;
+}
+
+// Returns the header of a mapped *.pcb file, NULL if the file is not a valid *.pcb file.
+inline const PointCloudBinaryHeader* readPointCloudBinary(const MappedFile& file)
+{
+	if (!file.IsOpen() || file.Size() < sizeof(PointCloudBinaryHeader)) return NULL;
+	const PointCloudBinaryHeader* header = (const PointCloudBinaryHeader*)file.Data();
+	if (memcmp(header->magic, PCB_MAGIC, sizeof(PCB_MAGIC)) != 0) return NULL;
+
+	// The arrays are used in place, so they must be aligned (the mapping starts on a page)
+	uint64_t arrays = (header->attributes & PCB_NORMALS) ? 2 : 1;
+	if (header->headerSize < sizeof(PointCloudBinaryHeader) ||
+		header->headerSize % alignof(glm::vec3) != 0 ||
+		header->count > (uint64_t)INT_MAX ||
+		file.Size() < header->headerSize + arrays * header->count * sizeof(glm::vec3))
+	{
+		printf("readPointCloudBinary error:  truncated or corrupt file\n");
+		return NULL;
+	}
+
+	return header;
+}
+
+// Positions of a header returned by readPointCloudBinary(...)
+inline const glm::vec3* pointCloudBinaryPoints(const PointCloudBinaryHeader* header)
+{
+	return (const glm::vec3*)((const char*)header + header->headerSize);
+}
+
+// Normals of a header returned by readPointCloudBinary(...), NULL if there are none
+inline const glm::vec3* pointCloudBinaryNormals(const PointCloudBinaryHeader* header)
+{
+	if (!(header->attributes & PCB_NORMALS)) return NULL;
+	return pointCloudBinaryPoints(header) + header->count;
+}
+
+// Header for count points with the given bounds and PointCloudBinaryAttribute flags
+inline PointCloudBinaryHeader pointCloudBinaryHeader(uint64_t count, uint32_t attributes,
+	const glm::vec3& min, const glm::vec3& max, float boundingRadius)
+{
+	PointCloudBinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PCB_MAGIC, sizeof(PCB_MAGIC));
+	header.headerSize = sizeof(PointCloudBinaryHeader);
+	header.count = count;
+	header.attributes = attributes;
+	header.boundingRadius = boundingRadius;
+	for_int(c, 3) { header.min[c] = min[c]; header.max[c] = max[c]; }
+	return header;
+}
+
+inline bool writePointCloudBinary(const char* fileName, int nVertices, const glm::vec3* points,
+	const glm::vec3* normals = NULL)
+{
+	glm::vec3 min = glm::vec3(float(INT_MAX)), max = glm::vec3(float(INT_MIN));
+	float boundingRadius = 0.0f;
+	for (int i = 0; i < nVertices; i++)
+	{
+		for_int(c, 3)
+		{
+			if (min[c] > points[i][c]) min[c] = points[i][c];
+			if (max[c] < points[i][c]) max[c] = points[i][c];
+			if (boundingRadius < std::abs(points[i][c])) boundingRadius = std::abs(points[i][c]);
+		}
+	}
+
+	PointCloudBinaryHeader header = pointCloudBinaryHeader(nVertices, normals != NULL ? PCB_NORMALS : 0,
+		min, max, boundingRadius);
+
+	FILE* fileOut = fopen(fileName, "wb");
+	if (fileOut == NULL)
+	{
+		printf("writePointCloudBinary error:  can't open %s\n", fileName);
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, fileOut) == 1;
+	if (ok && nVertices > 0) ok = fwrite(points, sizeof(glm::vec3), nVertices, fileOut) == (size_t)nVertices;
+	if (ok && nVertices > 0 && normals != NULL) ok = fwrite(normals, sizeof(glm::vec3), nVertices, fileOut) == (size_t)nVertices;
+	ok = fclose(fileOut) == 0 && ok;
+
+	if (!ok) printf("writePointCloudBinary error:  failed writing %s\n", fileName);
+	return ok;
+}
+
+// Convert a *.pcd text file (count followed by x y z lines) to a *.pcb file.
+inline bool convertPointCloud(const char* pcdFile, const char* pcbFile)
+{
+	std::vector<glm::vec3> points;
+	glm::vec3 min, max;
+	if (readPointCloud(pcdFile, &points, min, max) == -1.0f) return false;
+
+	if (!writePointCloudBinary(pcbFile, (int)points.size(), points.data())) return false;
+	printf("converted %s to %s with %d vertices\n", pcdFile, pcbFile, (int)points.size());
+	return true;
+}
+
+#endif
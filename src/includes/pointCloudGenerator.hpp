@@ -0,0 +1,239 @@
+/*
+pointCloudGenerator.hpp
+
+Synthetic point clouds sampled from analytic surfaces, for testing and
+stressing the reconstruction at any size without shipping large files.
+
+Shapes (about unit size, centered on the origin):
+	sphere  unit sphere
+	cube    surface of the [-1, 1] cube
+	torus   major radius 1, minor radius 0.4, around z
+	knot    tube of radius 0.12 around a trefoil knot
+
+Points are uniform over the surface area (the knot ignores the small
+curvature term).  With nonUniform the density falls off linearly along x to
+a tenth at x = -1.  With noise > 0 every point is displaced along its normal
+by a gaussian with that standard deviation.
+
+Every point draws from its own random stream, seeded by the seed and its
+index, so the output only depends on the settings and not on the thread
+count or block size.
+
+generatePoints(...) fills points (and normals if not NULL) in parallel.
+generatePointCloud(...) streams a *.pcb file block by block, so 100M point
+clouds only need one block in memory.  With normals the normal array is
+written in a second, identical pass.
+*/
+
+#ifndef __POINT_CLOUD_GENERATOR__
+#define __POINT_CLOUD_GENERATOR__
+
+#include <stdint.h>
+
+enum PointCloudShape { SHAPE_INVALID, SHAPE_SPHERE, SHAPE_CUBE, SHAPE_TORUS, SHAPE_KNOT };
+
+struct GeneratorSettings
+{
+	PointCloudShape shape;
+	int count; // number of points
+	uint64_t seed;
+	float noise; // standard deviation of the displacement along the normal
+	bool nonUniform; // density falling off along x
+	bool normals; // also write the surface normals
+};
+
+inline PointCloudShape pointCloudShape(const std::string& name)
+{
+	if (name == "sphere") return SHAPE_SPHERE;
+	if (name == "cube") return SHAPE_CUBE;
+	if (name == "torus") return SHAPE_TORUS;
+	if (name == "knot") return SHAPE_KNOT;
+	return SHAPE_INVALID;
+}
+
+// Counter based random stream (splitmix64), one per point
+class GeneratorRandom
+{
+public:
+	GeneratorRandom(uint64_t seed, uint64_t index) : m_iState(seed)
+	{
+		m_iState = Next() ^ (index * 0xD1B54A32D192ED03ull);
+	}
+
+	uint64_t Next()
+	{
+		uint64_t z = (m_iState += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// Uniform in [0, 1)
+	float Uniform() { return (float)(Next() >> 40) * (1.0f / 16777216.0f); }
+
+	// Standard normal (Box-Muller)
+	float Gaussian()
+	{
+		float u1 = 1.0f - Uniform(), u2 = Uniform();
+		return std::sqrt(-2.0f * std::log(u1)) * std::cos(2.0f * glm::pi<float>() * u2);
+	}
+
+private:
+	uint64_t m_iState;
+};
+
+// Sample of the shape surface without noise or density changes
+inline void generateSurfacePoint(PointCloudShape shape, GeneratorRandom& random, glm::vec3& point, glm::vec3& normal)
+{
+	switch (shape)
+	{
+	case SHAPE_SPHERE:
+	{
+		float z = 2.0f * random.Uniform() - 1.0f, theta = 2.0f * glm::pi<float>() * random.Uniform();
+		float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+		normal = glm::vec3(r * std::cos(theta), r * std::sin(theta), z);
+		point = normal;
+		break;
+	}
+	case SHAPE_CUBE:
+	{
+		int face = std::min((int)(random.Uniform() * 6.0f), 5);
+		int axis = face / 2;
+		float side = face % 2 ? 1.0f : -1.0f;
+		point[axis] = side;
+		point[(axis + 1) % 3] = 2.0f * random.Uniform() - 1.0f;
+		point[(axis + 2) % 3] = 2.0f * random.Uniform() - 1.0f;
+		normal = glm::vec3(0.0f);
+		normal[axis] = side;
+		break;
+	}
+	case SHAPE_TORUS:
+	{
+		const float R = 1.0f, r = 0.4f;
+		float u, v;
+		do // area element is proportional to R + r cos(v)
+		{
+			u = 2.0f * glm::pi<float>() * random.Uniform();
+			v = 2.0f * glm::pi<float>() * random.Uniform();
+		} while (random.Uniform() * (R + r) > R + r * std::cos(v));
+		normal = glm::vec3(std::cos(v) * std::cos(u), std::cos(v) * std::sin(u), std::sin(v));
+		point = glm::vec3((R + r * std::cos(v)) * std::cos(u), (R + r * std::cos(v)) * std::sin(u), r * std::sin(v));
+		break;
+	}
+	case SHAPE_KNOT:
+	{
+		// Trefoil c(t) = (sin t + 2 sin 2t, cos t - 2 cos 2t, -sin 3t) / 3, |c'(t)| <= sqrt(34) / 3
+		const float r = 0.12f, maxSpeed = std::sqrt(34.0f) / 3.0f;
+		float t;
+		glm::vec3 tangent;
+		do // area element is proportional to |c'(t)|
+		{
+			t = 2.0f * glm::pi<float>() * random.Uniform();
+			tangent = glm::vec3(std::cos(t) + 4.0f * std::cos(2.0f * t), -std::sin(t) + 4.0f * std::sin(2.0f * t),
+				-3.0f * std::cos(3.0f * t)) / 3.0f;
+		} while (random.Uniform() * maxSpeed > glm::length(tangent));
+		glm::vec3 center = glm::vec3(std::sin(t) + 2.0f * std::sin(2.0f * t), std::cos(t) - 2.0f * std::cos(2.0f * t),
+			-std::sin(3.0f * t)) / 3.0f;
+		tangent = glm::normalize(tangent);
+		glm::vec3 axis = std::abs(tangent.z) < 0.9f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 n1 = glm::normalize(glm::cross(tangent, axis));
+		glm::vec3 n2 = glm::cross(tangent, n1);
+		float phi = 2.0f * glm::pi<float>() * random.Uniform();
+		normal = std::cos(phi) * n1 + std::sin(phi) * n2;
+		point = center + r * normal;
+		break;
+	}
+	default:
+		point = normal = glm::vec3(0.0f);
+		break;
+	}
+}
+
+// Point index of a generated cloud
+inline void generatePoint(const GeneratorSettings& settings, int64_t index, glm::vec3& point, glm::vec3& normal)
+{
+	GeneratorRandom random(settings.seed, (uint64_t)index);
+	for (;;)
+	{
+		generateSurfacePoint(settings.shape, random, point, normal);
+		if (!settings.nonUniform) break;
+		float density = 0.1f + 0.9f * std::min(std::max(0.5f + 0.5f * point.x, 0.0f), 1.0f);
+		if (random.Uniform() < density) break;
+	}
+	if (settings.noise > 0.0f) point += settings.noise * random.Gaussian() * normal;
+}
+
+// Points [first, first + count) of a generated cloud, on all threads
+inline void generatePoints(const GeneratorSettings& settings, int64_t first, int count, glm::vec3* points, glm::vec3* normals)
+{
+	const int blockSize = 1 << 14;
+	int nBlocks = (count + blockSize - 1) / blockSize;
+	parallelFor(nBlocks, [&](int block)
+	{
+		int last = std::min(count, (block + 1) * blockSize);
+		for (int i = block * blockSize; i < last; i++)
+		{
+			glm::vec3 point, normal;
+			generatePoint(settings, first + i, point, normal);
+			if (points != NULL) points[i] = point;
+			if (normals != NULL) normals[i] = normal;
+		}
+	});
+}
+
+inline bool generatePointCloud(const char* fileName, const GeneratorSettings& settings)
+{
+	if (settings.shape == SHAPE_INVALID || settings.count <= 0)
+	{
+		printf("generatePointCloud error:  invalid shape or count\n");
+		return false;
+	}
+
+	FILE* fileOut = fopen(fileName, "wb");
+	if (fileOut == NULL)
+	{
+		printf("generatePointCloud error:  can't open %s\n", fileName);
+		return false;
+	}
+
+	// Placeholder header, the bounds are only known at the end
+	PointCloudBinaryHeader header = pointCloudBinaryHeader(settings.count, 0, glm::vec3(0.0f), glm::vec3(0.0f), 0.0f);
+	bool ok = fwrite(&header, sizeof(header), 1, fileOut) == 1;
+
+	const int blockSize = 1 << 20;
+	std::vector<glm::vec3> block(std::min(settings.count, blockSize));
+	glm::vec3 min = glm::vec3(float(INT_MAX)), max = glm::vec3(float(INT_MIN));
+	float boundingRadius = 0.0f;
+	int nPasses = settings.normals ? 2 : 1;
+	for (int pass = 0; pass < nPasses && ok; pass++)
+	{
+		for (int first = 0; first < settings.count && ok; first += blockSize)
+		{
+			int n = std::min(blockSize, settings.count - first);
+			generatePoints(settings, first, n, pass == 0 ? block.data() : NULL, pass == 1 ? block.data() : NULL);
+			if (pass == 0)
+			{
+				for (int i = 0; i < n; i++)
+				{
+					for_int(c, 3)
+					{
+						if (min[c] > block[i][c]) min[c] = block[i][c];
+						if (max[c] < block[i][c]) max[c] = block[i][c];
+						if (boundingRadius < std::abs(block[i][c])) boundingRadius = std::abs(block[i][c]);
+					}
+				}
+			}
+			ok = fwrite(block.data(), sizeof(glm::vec3), n, fileOut) == (size_t)n;
+		}
+	}
+
+	header = pointCloudBinaryHeader(settings.count, settings.normals ? PCB_NORMALS : 0, min, max, boundingRadius);
+	ok = ok && fseek(fileOut, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fileOut) == 1;
+	ok = fclose(fileOut) == 0 && ok;
+
+	if (!ok) printf("generatePointCloud error:  failed writing %s\n", fileName);
+	else printf("generated %s with %d vertices\n", fileName, settings.count);
+	return ok;
+}
+
+#endif
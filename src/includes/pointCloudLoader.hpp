@@ -1,26 +1,11 @@
 /*
-triModel465.hpp
+pointCloudLoader.hpp
 
-Two utility functions:  loadTriModel(...) and loadModelBuffer(...)
+Point cloud *.pcd text files:  a vertex count followed by x y z lines.
 
-Using loadModelBuffer(...) in your OpenGL core application will call
-loadTriModel(...) to read the model's file data.
-
-LoadTriModel(...) reads a *.tri model file exported from AC3D and creates
-glm::vec4 arrays for vertex and color and a glm::vec3 array normal for
-surface data.  A vec4 color value and a vec3 normal value is computed
-for every vertex (not surface).
-
-The 3 glm::vec? parameters are empty on call and with values
-on return.
-
-Function's 4 assumptions:
-1.  the *.tri model is centered at (0,0,0).
-2.  The *.tri model has only triangles, no co-linear edges/triangle
-2.  the *.tri model's vertices have been optimized ( Object | OptimizeVertices ... )
-3.  the *.tri model's surfaces have been optimized ( Object | OptimizeSurfaces ... )
-
-Use loadModelBuffer(...) to set *.tri model data into vao's vbo buffer.
+readPointCloud(...) parses a file on the CPU only, no GL context is needed,
+and returns the positions, bounds and bounding radius.
+writePointCloud(...) writes positions as a *.pcd file.
 
 Functions prints various error messages, with error returns -1.0f
 Functions returns the bounding radius of the model with valid model file.
@@ -41,145 +26,204 @@ Mike Barnes
 
 #include "includes.hpp"
 
-inline float* loadPointCloud(char* fileName,
-	GLuint vao, GLuint vbo, GLuint shaderProgram,
-	GLuint vPosition, GLuint vColor, GLuint vNormal,
-	std::vector<glm::vec3>* points, glm::vec3& min, glm::vec3& max) 
+// Parse a decimal float (e.g. -1.25e-3) at p without reading at or past end.
+// Returns the position after the number, or p if there is no number.
+inline const char* parseFloat(const char* p, const char* end, float& value)
 {
-	const int X = 0, Y = 1, Z = 2;
-	FILE * fileIn;
-	glm::vec3 point;
-	glm::vec4 pColor = glm::vec4(1, 1, 1, 1);
-	bool done;
-	float coord[3];  // points's x, y, z values
-	float maxAxes[3] = { -1000.0f, -1000.0f, -1000.0f }; // maximum lenght of x, y, and z from center
-	int count = 0, vertexCount = 0, normalCount = 0, colorCount = 0;
-	int* nVertices = new int(-1);
+	static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	const char* start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+	double mantissa = 0.0;
+	int exponent = 0;
+	bool digits = false;
+	for (; p < end && *p >= '0' && *p <= '9'; p++) { mantissa = mantissa * 10.0 + (*p - '0'); digits = true; }
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++) { mantissa = mantissa * 10.0 + (*p - '0'); exponent--; digits = true; }
+	}
+	if (!digits) return start;
 
-	min = glm::vec3(float(INT_MAX));
-	max = glm::vec3(float(INT_MIN));
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* e = p + 1;
+		bool eNegative = false;
+		if (e < end && (*e == '-' || *e == '+')) eNegative = *e++ == '-';
+		int eValue = 0;
+		const char* eDigits = e;
+		for (; e < end && *e >= '0' && *e <= '9'; e++) { if (eValue < 10000) eValue = eValue * 10 + (*e - '0'); }
+		if (e != eDigits) { exponent += eNegative ? -eValue : eValue; p = e; }
+	}
 
-	// set dynamic array sizes
-	int vec3Size = 0;
-	int vec4Size = 0;
-	// allocate dynamic arrays
-	glm::vec4* vertex = NULL;
-	glm::vec4* color = NULL;
-	glm::vec3* normal = NULL;
+	if (exponent < 0) mantissa = -exponent <= 22 ? mantissa / powers[-exponent] : mantissa * pow(10.0, exponent);
+	else if (exponent > 0) mantissa = exponent <= 22 ? mantissa * powers[exponent] : mantissa * pow(10.0, exponent);
+	value = float(negative ? -mantissa : mantissa);
+	return p;
+}
+
+// Read a *.pcd text file on the CPU only, no GL context is needed.
+// Fills points and the bounds, returns the bounding radius or -1.0f on error.
+// The mapped file is split into newline aligned chunks, the points of each chunk are
+// counted, then parsed on all threads straight into their place in points, reducing
+// bounds per chunk.
+inline float readPointCloud(const char* fileName,
+	std::vector<glm::vec3>* points, glm::vec3& min, glm::vec3& max)
+{
+	MappedFile file(fileName);
+	if (!file.IsOpen())
+	{
+		printf("readPointCloud error:  can't open %s\n", fileName);
+		return -1.0f;
+	}
+
+	const char* p = file.Data();
+	const char* end = p + file.Size();
+	int nVertices = 0;
+	while (p < end && isspace((unsigned char)*p)) p++;
+	const char* countStart = p;
+	for (; p < end && *p >= '0' && *p <= '9'; p++)
+	{
+		if (nVertices > (INT_MAX - 9) / 10)
+		{
+			printf("readPointCloud error:  vertex count too large in %s\n", fileName);
+			return -1.0f;
+		}
+		nVertices = nVertices * 10 + (*p - '0');
+	}
+	if (p == countStart)
+	{
+		printf("readPointCloud error: no vertices defined %s\n", fileName);
+		return -1.0f;
+	}
+
+	// Split the rest of the file into chunks that start at a line
+	const int minChunkSize = 1 << 16;
+	int nChunks = (int)std::min<size_t>((end - p) / minChunkSize + 1, (size_t)threadCount() * 4);
+	std::vector<const char*> bounds(nChunks + 1);
+	bounds[0] = p;
+	bounds[nChunks] = end;
+	for (int i = 1; i < nChunks; i++)
+	{
+		const char* b = p + (end - p) / nChunks * i;
+		if (b < bounds[i - 1]) b = bounds[i - 1];
+		const char* eol = (const char*)memchr(b, '\n', end - b);
+		bounds[i] = eol != NULL ? eol + 1 : end;
+	}
 
-	fileIn = fopen(fileName, "r");
-	if (fileIn != NULL)
+	// Count the non-blank lines of each chunk
+	std::vector<int> offsets(nChunks + 1, 0);
+	parallelFor(nChunks, [&](int chunk)
 	{
-		while (!feof(fileIn))
+		int count = 0;
+		for (const char* line = bounds[chunk]; line < bounds[chunk + 1];)
 		{
-			done = false;
-			if (*nVertices == -1)
+			const char* eol = (const char*)memchr(line, '\n', bounds[chunk + 1] - line);
+			if (eol == NULL) eol = bounds[chunk + 1];
+			for (const char* c = line; c < eol; c++)
 			{
-				if (fscanf(fileIn, "%i", nVertices) == EOF)
-				{
-					printf("loadPointCloud error: no vertices defined %s\n", fileName);
-					float* toReturn = new float[2]{ -1.0f, -1.0f };
-					return toReturn;  // just to satisfy the compiler
-				}
-				vec3Size = *nVertices * sizeof(glm::vec3);
-				vec4Size = *nVertices * sizeof(glm::vec4);
-				vertex = (glm::vec4 *) calloc(vec4Size, sizeof(glm::vec4));
-				color = (glm::vec4 *) calloc(vec4Size, sizeof(glm::vec4));
-				normal = (glm::vec3 *) calloc(vec3Size, sizeof(glm::vec3));
+				if (!isspace((unsigned char)*c)) { count++; break; }
 			}
+			line = eol + 1;
+		}
+		offsets[chunk + 1] = count;
+	});
+	for (int i = 0; i < nChunks; i++) offsets[i + 1] += offsets[i];
+
+	if (offsets[nChunks] != nVertices)
+	{
+		printf("readPointCloud error:  count of vertices mismatch:  vertexCount %4d != nVertices %4d\n",
+			offsets[nChunks], nVertices);
+		return -1.0f;
+	}
 
-			for (int i = 0; i < 3; i++)
+	// Parse each chunk into its slice of points
+	points->resize(nVertices);
+	glm::vec3* out = points->data();
+	std::vector<glm::vec3> chunkMin(nChunks, glm::vec3(float(INT_MAX))), chunkMax(nChunks, glm::vec3(float(INT_MIN)));
+	std::vector<float> chunkRadius(nChunks, -1.0f);
+	std::atomic<int> badLines(0), badChunks(0);
+	parallelFor(nChunks, [&](int chunk)
+	{
+		glm::vec3 cMin = chunkMin[chunk], cMax = chunkMax[chunk];
+		float cRadius = -1.0f;
+		int index = offsets[chunk], indexEnd = offsets[chunk + 1];
+		for (const char* line = bounds[chunk]; line < bounds[chunk + 1];)
+		{
+			const char* eol = (const char*)memchr(line, '\n', bounds[chunk + 1] - line);
+			if (eol == NULL) eol = bounds[chunk + 1];
+			const char* c = line;
+			while (c < eol && isspace((unsigned char)*c)) c++;
+			if (c < eol)
 			{
-				coord[i] = -99999.9f;
-				if (fscanf(fileIn, "%f", &coord[i]) == EOF) // at EOF
+				if (index == indexEnd) { badChunks++; break; } // more points than counted
+				glm::vec3 point;
+				int nCoords = 0;
+				for (; nCoords < 3; nCoords++)
 				{
-					done = true;
-					break;
+					while (c < eol && isspace((unsigned char)*c)) c++;
+					const char* next = parseFloat(c, eol, point[nCoords]);
+					if (next == c) break;
+					c = next;
 				}
-			}
-
-			if (!done)
-			{
-				// create vertices and normals
-				// std::abs(....) is used instead of abs(...) because g++ does not provide float abs(float)
-				point = glm::vec3(coord[X], coord[Y], coord[Z]);
-				points->push_back(point);
-				// update maxAxes for model's bounding sphere
+				if (nCoords < 3)
+				{
+					badLines++;
+					point = glm::vec3();
+				}
+				out[index++] = point;
 				for_int(i, 3)
 				{
-					if (maxAxes[i] < std::abs(coord[i])) maxAxes[i] = std::abs(coord[i]);
-					if (min[i] > coord[i]) min[i] = coord[i];
-					if (max[i] < coord[i]) max[i] = coord[i];
+					if (cRadius < std::abs(point[i])) cRadius = std::abs(point[i]);
+					if (cMin[i] > point[i]) cMin[i] = point[i];
+					if (cMax[i] < point[i]) cMax[i] = point[i];
 				}
-				
-				if (vertex != NULL) vertex[vertexCount++] = glm::vec4(point.x, point.y, point.z, 1.0f);
-				if (color != NULL) color[colorCount++] = pColor;
-				if (normal != NULL) normal[normalCount++] = glm::vec3(0, 0, 1);
-				count++;
-			}  // ! done
-			   // create vertexs, normal, color 
-		} // while ! eof
-
-		fclose(fileIn);
-	} // if
-	else // file is null
+			}
+			line = eol + 1;
+		}
+		if (index != indexEnd) badChunks++;
+		chunkMin[chunk] = cMin;
+		chunkMax[chunk] = cMax;
+		chunkRadius[chunk] = cRadius;
+	});
+
+	if (badChunks > 0)
+	{
+		printf("readPointCloud error:  parsed points disagree with the vertex count in %s\n", fileName);
+		points->clear();
+		return -1.0f;
+	}
+	if (badLines > 0)
 	{
-		printf("loadPointCloud error:  can't open %s\n", fileName);
-		float* toReturn = new float[2]{ -1.0f, -1.0f };
-		return toReturn;  // just to satisfy the compiler
+		printf("readPointCloud error:  %d lines without 3 coordinates in %s\n", (int)badLines, fileName);
+		points->clear();
+		return -1.0f;
 	}
 
-	if (vertexCount != *nVertices) {
-		printf("loadPointCloud error:  count of vertices mismatch:  vertexCount %4d != nVertices %4d\n",
-			vertexCount, *nVertices);
-		float* toReturn = new float[2]{ -1.0f, (float)*nVertices };
-		return toReturn;  // just to satisfy the compiler
+	// Reduce chunk bounds
+	min = glm::vec3(float(INT_MAX));
+	max = glm::vec3(float(INT_MIN));
+	float boundingRadius = -1.0f;
+	for (int chunk = 0; chunk < nChunks; chunk++)
+	{
+		for_int(i, 3)
+		{
+			if (min[i] > chunkMin[chunk][i]) min[i] = chunkMin[chunk][i];
+			if (max[i] < chunkMax[chunk][i]) max[i] = chunkMax[chunk][i];
+		}
+		if (boundingRadius < chunkRadius[chunk]) boundingRadius = chunkRadius[chunk];
 	}
-	// bounding radius
-	float boundingRadius = -1;
-	if (maxAxes[X] >= maxAxes[Y] && maxAxes[X] >= maxAxes[Z]) boundingRadius = maxAxes[X];
-	if (maxAxes[Y] >= maxAxes[X] && maxAxes[Y] >= maxAxes[Z]) boundingRadius = maxAxes[Y];
-	if (maxAxes[Z] >= maxAxes[X] && maxAxes[Z] >= maxAxes[Y]) boundingRadius = maxAxes[Z];
 
 	if (boundingRadius == -1.0f)
 	{
-		printf("loadPointCloud error:  returned -1.0f \n");
-		float* toReturn = new float[2]{ -1.0f, (float)*nVertices };
-		return toReturn;  // just to satisfy the compiler
+		printf("readPointCloud error:  returned -1.0f \n");
+		return -1.0f;
 	}
 	else
-		printf("loaded %s model with %7.2f bounding radius and %d vertices\n", fileName, boundingRadius, *nVertices);
-
-	//glm::vec3 vectorMinToMax = max - min;
-	//glm::vec3 mid = glm::vec3(vectorMinToMax.x / 2 + min.x, vectorMinToMax.y / 2 + min.y, vectorMinToMax.z / 2 + min.z);
-	//max = glm::normalize(max - mid) * cubeHypotenuse(boundingRadius) + mid;
-	//min = glm::normalize(min - mid) * cubeHypotenuse(boundingRadius) + mid;
-
-	// fill the point cloud's buffer
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, 2 * vec4Size + vec3Size, NULL, GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, vec4Size, vertex);
-	glBufferSubData(GL_ARRAY_BUFFER, vec4Size, vec4Size, color);
-	glBufferSubData(GL_ARRAY_BUFFER, 2 * vec4Size, vec3Size, normal);
-	// set vertex shader variable handles
-	vPosition = glGetAttribLocation(shaderProgram, "vPosition");
-	glEnableVertexAttribArray(vPosition);
-	glVertexAttribPointer(vPosition, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
-	vColor = glGetAttribLocation(shaderProgram, "vColor");
-	glEnableVertexAttribArray(vColor);
-	glVertexAttribPointer(vColor, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(vec4Size));
-	vNormal = glGetAttribLocation(shaderProgram, "vNormal");
-	glEnableVertexAttribArray(vNormal);
-	glVertexAttribPointer(vNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(2 * vec4Size));
-
-	printf("vPosition %d, vColor %d, vNormal %d \n", vPosition, vColor, vNormal);
-	// reclaim dynamically allocated memory
-	free(vertex);
-	free(color);
-	free(normal);
-	float* toReturn = new float[2]{ boundingRadius, (float)*nVertices };
-	return toReturn;  // just to satisfy the compiler
+		printf("loaded %s model with %7.2f bounding radius and %d vertices\n", fileName, boundingRadius, nVertices);
+
+	return boundingRadius;
 }
 
 inline bool writePointCloud(char* fileName, int nVertices, const std::vector<glm::vec3>& points)
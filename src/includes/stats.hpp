@@ -0,0 +1,313 @@
+/*
+stats.hpp
+
+Run statistics:  nested scoped timers and named counters, reported as a
+tree on stdout or as JSON.
+
+ScopedTimer timer("name") times its scope with elapsedTime() and adds it to
+the node "name" under the timer that is open on the same thread (the root
+on threads without an open timer).  Repeated scopes accumulate time and
+calls in the same node.
+
+statCounter("name") returns the counter of that name, created at zero on
+the first call.  Keep the reference in a static for hot code, counters are
+atomic and can be added to from any thread.  addStat("name", n) looks the
+counter up every time, for code that runs rarely.
+
+LocalStatCounter counter("name") adds to statCounter("name") without shared
+atomics in hot code:  each thread adds to its own count, which reaches the
+counter when the thread calls flushStats() (parallelFor(...) workers do after
+every parallel loop) or exits.  Keep it in a static.  The report functions
+flush the calling thread themselves.
+
+recordMemory("stage", structures) snapshots the current and peak resident
+set size together with the bytes held by the named structures.
+
+resetStats() zeroes all counters and drops all timers and memory snapshots,
+call it with no timers open.  printStats() prints the timers, counters and
+memory snapshots, writeStats(...) writes them as JSON:
+	{ "timers": { "name": "run", "ms": .., "calls": .., "children": [ .. ] },
+	  "counters": { "name": value, .. },
+	  "memory": [ { "stage": .., "current_rss": .., "peak_rss": .., "structures": { "name": bytes, .. } }, .. ] }
+*/
+
+#ifndef __STATS__
+#define __STATS__
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+struct StatTimerNode
+{
+	std::string name;
+	double ms;
+	int64_t calls;
+	StatTimerNode* parent;
+	std::vector<std::unique_ptr<StatTimerNode>> children;
+};
+
+struct StatMemory
+{
+	std::string stage;
+	size_t currentRss;
+	size_t peakRss;
+	std::vector<std::pair<std::string, size_t>> structures; // name, bytes
+};
+
+inline std::mutex& statMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+inline StatTimerNode& statRoot()
+{
+	static StatTimerNode root = { "run", 0.0, 0, NULL, std::vector<std::unique_ptr<StatTimerNode>>() };
+	return root;
+}
+
+// Innermost open timer of the calling thread, NULL if none
+inline StatTimerNode*& statCurrent()
+{
+	static thread_local StatTimerNode* current = NULL;
+	return current;
+}
+
+inline std::map<std::string, std::unique_ptr<std::atomic<int64_t>>>& statCounters()
+{
+	static std::map<std::string, std::unique_ptr<std::atomic<int64_t>>> counters;
+	return counters;
+}
+
+inline std::atomic<int64_t>& statCounter(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(statMutex());
+	std::unique_ptr<std::atomic<int64_t>>& counter = statCounters()[name];
+	if (!counter) counter.reset(new std::atomic<int64_t>(0));
+	return *counter;
+}
+
+inline void addStat(const std::string& name, int64_t value)
+{
+	statCounter(name) += value;
+}
+
+// Counters of the LocalStatCounter slots
+inline std::vector<std::atomic<int64_t>*>& statLocalSlots()
+{
+	static std::vector<std::atomic<int64_t>*> slots;
+	return slots;
+}
+
+// Counts of one thread by LocalStatCounter slot, flushed at thread exit
+struct StatLocalCounts
+{
+	std::vector<int64_t> values;
+
+	~StatLocalCounts() { flush(); }
+
+	void flush()
+	{
+		std::lock_guard<std::mutex> lock(statMutex());
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			if (values[i] != 0) statLocalSlots()[i]->fetch_add(values[i], std::memory_order_relaxed);
+			values[i] = 0;
+		}
+	}
+};
+
+inline StatLocalCounts& statLocalCounts()
+{
+	static thread_local StatLocalCounts counts;
+	return counts;
+}
+
+class LocalStatCounter
+{
+public:
+	explicit LocalStatCounter(const std::string& name)
+	{
+		std::atomic<int64_t>* counter = &statCounter(name);
+		std::lock_guard<std::mutex> lock(statMutex());
+		m_iSlot = statLocalSlots().size();
+		statLocalSlots().push_back(counter);
+	}
+
+	LocalStatCounter& operator+=(int64_t value)
+	{
+		std::vector<int64_t>& values = statLocalCounts().values;
+		if (m_iSlot >= values.size()) values.resize(m_iSlot + 1, 0);
+		values[m_iSlot] += value;
+		return *this;
+	}
+
+	LocalStatCounter(const LocalStatCounter&) = delete;
+	LocalStatCounter& operator=(const LocalStatCounter&) = delete;
+
+private:
+	size_t m_iSlot;
+};
+
+// Add the calling thread's LocalStatCounter counts to the counters
+inline void flushStats()
+{
+	statLocalCounts().flush();
+}
+
+inline std::vector<StatMemory>& statMemory()
+{
+	static std::vector<StatMemory> memory;
+	return memory;
+}
+
+inline void recordMemory(const char* stage, const std::vector<std::pair<std::string, size_t>>& structures)
+{
+	StatMemory memory = { stage, currentResidentBytes(), peakResidentBytes(), structures };
+	std::lock_guard<std::mutex> lock(statMutex());
+	statMemory().push_back(memory);
+}
+
+class ScopedTimer
+{
+public:
+	explicit ScopedTimer(const char* name) : m_pPrevious(statCurrent())
+	{
+		std::lock_guard<std::mutex> lock(statMutex());
+		StatTimerNode* parent = m_pPrevious != NULL ? m_pPrevious : &statRoot();
+		m_pNode = NULL;
+		for (std::unique_ptr<StatTimerNode>& child : parent->children)
+		{
+			if (child->name == name) { m_pNode = child.get(); break; }
+		}
+		if (m_pNode == NULL)
+		{
+			parent->children.emplace_back(new StatTimerNode{ name, 0.0, 0, parent, std::vector<std::unique_ptr<StatTimerNode>>() });
+			m_pNode = parent->children.back().get();
+		}
+		statCurrent() = m_pNode;
+		m_dStart = elapsedTime();
+	}
+
+	~ScopedTimer()
+	{
+		double ms = Elapsed();
+		std::lock_guard<std::mutex> lock(statMutex());
+		m_pNode->ms += ms;
+		m_pNode->calls++;
+		statCurrent() = m_pPrevious;
+	}
+
+	// Milliseconds since the timer was opened
+	double Elapsed() const { return elapsedTime() - m_dStart; }
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+	StatTimerNode* m_pNode;
+	StatTimerNode* m_pPrevious;
+	double m_dStart;
+};
+
+inline void resetStats()
+{
+	std::lock_guard<std::mutex> lock(statMutex());
+	assert(statCurrent() == NULL);
+	statRoot().children.clear();
+	for (auto& counter : statCounters()) { *counter.second = 0; }
+	for (int64_t& value : statLocalCounts().values) { value = 0; }
+	statMemory().clear();
+}
+
+inline void printStatTimer(const StatTimerNode& node, int depth)
+{
+	printf("%*s%-*s %12.3f ms %8lld calls\n", 2 * depth, "", 32 - 2 * depth, node.name.c_str(), node.ms, (long long)node.calls);
+	for (const std::unique_ptr<StatTimerNode>& child : node.children) { printStatTimer(*child, depth + 1); }
+}
+
+inline void printStats()
+{
+	flushStats();
+	std::lock_guard<std::mutex> lock(statMutex());
+	printf("Timers:\n");
+	for (const std::unique_ptr<StatTimerNode>& child : statRoot().children) { printStatTimer(*child, 1); }
+	printf("Counters:\n");
+	for (auto& counter : statCounters())
+	{
+		printf("  %-32s %14lld\n", counter.first.c_str(), (long long)counter.second->load());
+	}
+	if (!statMemory().empty()) printf("Memory (MB):\n");
+	for (const StatMemory& memory : statMemory())
+	{
+		printf("  %-16s rss %9.1f  peak %9.1f ", memory.stage.c_str(), memory.currentRss / 1048576.0, memory.peakRss / 1048576.0);
+		for (const auto& structure : memory.structures)
+		{
+			printf(" %s %.1f", structure.first.c_str(), structure.second / 1048576.0);
+		}
+		printf("\n");
+	}
+}
+
+inline void writeStatTimer(FILE* fileOut, const StatTimerNode& node, int depth)
+{
+	fprintf(fileOut, "%*s{ \"name\": \"%s\", \"ms\": %.3f, \"calls\": %lld", 2 * depth, "", node.name.c_str(), node.ms, (long long)node.calls);
+	if (!node.children.empty())
+	{
+		fprintf(fileOut, ", \"children\": [\n");
+		for (size_t i = 0; i < node.children.size(); i++)
+		{
+			writeStatTimer(fileOut, *node.children[i], depth + 2);
+			fprintf(fileOut, i + 1 < node.children.size() ? ",\n" : "\n");
+		}
+		fprintf(fileOut, "%*s]", 2 * depth + 2, "");
+	}
+	fprintf(fileOut, " }");
+}
+
+inline bool writeStats(const char* fileName)
+{
+	FILE* fileOut = fopen(fileName, "w");
+	if (fileOut == NULL)
+	{
+		printf("writeStats error:  can't open %s\n", fileName);
+		return false;
+	}
+
+	flushStats();
+	std::lock_guard<std::mutex> lock(statMutex());
+	StatTimerNode& root = statRoot();
+	root.ms = 0.0;
+	for (const std::unique_ptr<StatTimerNode>& child : root.children) { root.ms += child->ms; }
+	root.calls = 1;
+	fprintf(fileOut, "{\n  \"timers\":\n");
+	writeStatTimer(fileOut, root, 2);
+	fprintf(fileOut, ",\n  \"counters\": {");
+	bool first = true;
+	for (auto& counter : statCounters())
+	{
+		fprintf(fileOut, "%s\n    \"%s\": %lld", first ? "" : ",", counter.first.c_str(), (long long)counter.second->load());
+		first = false;
+	}
+	fprintf(fileOut, "\n  },\n  \"memory\": [");
+	for (size_t i = 0; i < statMemory().size(); i++)
+	{
+		const StatMemory& memory = statMemory()[i];
+		fprintf(fileOut, "%s\n    { \"stage\": \"%s\", \"current_rss\": %llu, \"peak_rss\": %llu, \"structures\": {",
+			i ? "," : "", memory.stage.c_str(), (unsigned long long)memory.currentRss, (unsigned long long)memory.peakRss);
+		for (size_t j = 0; j < memory.structures.size(); j++)
+		{
+			fprintf(fileOut, "%s \"%s\": %llu", j ? "," : "", memory.structures[j].first.c_str(),
+				(unsigned long long)memory.structures[j].second);
+		}
+		fprintf(fileOut, " } }");
+	}
+	fprintf(fileOut, "\n  ]\n}\n");
+
+	bool ok = fclose(fileOut) == 0;
+	if (!ok) printf("writeStats error:  failed writing %s\n", fileName);
+	return ok;
+}
+
+#endif
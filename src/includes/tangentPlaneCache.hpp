@@ -0,0 +1,152 @@
+/*
+tangentPlaneCache.hpp
+
+Binary cache of oriented tangent planes (*.tpc), so that reruns on the same
+points with the same tangent plane settings, e.g. to contour at other grid
+sizes, skip the estimation and orientation.  Meant to be memory mapped with
+MappedFile.
+
+Layout, all values little-endian:
+	TangentPlaneCacheHeader  (64 bytes)
+	count x float32[3]       tangent plane origins
+	count x float32[3]       oriented unit normals
+
+The files are content addressed:  a file is named after the hash of its key,
+the hash of the points together with every setting that changes the tangent
+planes.  The key is also stored in the header and compared on load, so a hash
+collision cannot return the planes of other points.
+
+contentHash(...) hashes bytes to 64 bits.
+tangentPlaneCachePath(...) returns the file of a key in a cache directory.
+readTangentPlaneCache(...) validates a mapped file against a key and returns its header.
+writeTangentPlaneCache(...) writes the planes of a key.
+*/
+
+#ifndef __TANGENT_PLANE_CACHE__
+#define __TANGENT_PLANE_CACHE__
+
+#include <stdint.h>
+
+const char TPC_MAGIC[4] = { 'T', 'P', 'C', '1' };
+
+struct TangentPlaneCacheKey
+{
+	uint64_t pointsHash; // contentHash of the points, in the order of the planes
+	uint64_t count; // number of points
+	int32_t minkintp, maxkintp; // min / max number of points in a tangent plane
+	float samplingDensity;
+	float searchEpsilon; // approximate nearest searches
+	uint32_t spatialIndex; // index of the nearest searches, which may break distance ties differently
+	uint32_t mortonOrder; // points reordered along a Morton curve
+};
+
+struct TangentPlaneCacheHeader
+{
+	char magic[4]; // TPC_MAGIC
+	uint32_t headerSize; // offset of the origin array
+	TangentPlaneCacheKey key;
+	uint32_t reserved[4];
+};
+
+static_assert(sizeof(TangentPlaneCacheKey) == 40, "TangentPlaneCacheKey must be 40 bytes");
+static_assert(sizeof(TangentPlaneCacheHeader) == 64, "TangentPlaneCacheHeader must be 64 bytes");
+
+// 64-bit hash of bytes[size], 8 bytes at a time with a final avalanche; not cryptographic
+inline uint64_t contentHash(const void* bytes, size_t size, uint64_t seed = 0)
+{
+	const uint64_t k1 = 0x9e3779b97f4a7c15ull, k2 = 0xc2b2ae3d27d4eb4full;
+	const unsigned char* p = (const unsigned char*)bytes;
+	uint64_t h = seed ^ (size * k1);
+	for (; size >= 8; p += 8, size -= 8)
+	{
+		uint64_t w; memcpy(&w, p, 8);
+		h ^= w * k2;
+		h = (h << 31 | h >> 33) * k1;
+	}
+	uint64_t w = 0; memcpy(&w, p, size);
+	h ^= w * k2;
+	h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+// File of the planes of key in directory dir
+inline std::string tangentPlaneCachePath(const char* dir, const TangentPlaneCacheKey& key)
+{
+	char name[32];
+	sprintf(name, "%016llx.tpc", (unsigned long long)contentHash(&key, sizeof(key)));
+	std::string path = dir;
+	if (!path.empty() && path.back() != '/' && path.back() != '\\') path += '/';
+	return path + name;
+}
+
+// Returns the header of a mapped *.tpc file, NULL if the file is not a valid *.tpc file of key.
+inline const TangentPlaneCacheHeader* readTangentPlaneCache(const MappedFile& file, const TangentPlaneCacheKey& key)
+{
+	if (!file.IsOpen() || file.Size() < sizeof(TangentPlaneCacheHeader)) return NULL;
+	const TangentPlaneCacheHeader* header = (const TangentPlaneCacheHeader*)file.Data();
+	if (memcmp(header->magic, TPC_MAGIC, sizeof(TPC_MAGIC)) != 0) return NULL;
+	if (memcmp(&header->key, &key, sizeof(key)) != 0) return NULL;
+
+	if (header->headerSize < sizeof(TangentPlaneCacheHeader) ||
+		file.Size() < header->headerSize + 2 * header->key.count * sizeof(glm::vec3))
+	{
+		printf("readTangentPlaneCache error:  truncated or corrupt file\n");
+		return NULL;
+	}
+
+	return header;
+}
+
+// Tangent plane origins of a header returned by readTangentPlaneCache(...)
+inline const glm::vec3* tangentPlaneCacheOrigins(const TangentPlaneCacheHeader* header)
+{
+	return (const glm::vec3*)((const char*)header + header->headerSize);
+}
+
+// Oriented normals of a header returned by readTangentPlaneCache(...)
+inline const glm::vec3* tangentPlaneCacheNormals(const TangentPlaneCacheHeader* header)
+{
+	return tangentPlaneCacheOrigins(header) + header->key.count;
+}
+
+// Write the key.count origins and normals of key to its file in directory dir.
+// The file is written under a temporary name and then renamed, so a reader never maps a partial file.
+inline bool writeTangentPlaneCache(const char* dir, const TangentPlaneCacheKey& key,
+	const glm::vec3* origins, const glm::vec3* normals)
+{
+	TangentPlaneCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TPC_MAGIC, sizeof(TPC_MAGIC));
+	header.headerSize = sizeof(TangentPlaneCacheHeader);
+	header.key = key;
+
+	std::string fileName = tangentPlaneCachePath(dir, key), tempName = fileName + ".tmp";
+	FILE* fileOut = fopen(tempName.c_str(), "wb");
+	if (fileOut == NULL)
+	{
+		printf("writeTangentPlaneCache error:  can't open %s\n", tempName.c_str());
+		return false;
+	}
+
+	size_t count = (size_t)key.count;
+	bool ok = fwrite(&header, sizeof(header), 1, fileOut) == 1;
+	if (ok && count > 0) ok = fwrite(origins, sizeof(glm::vec3), count, fileOut) == count;
+	if (ok && count > 0) ok = fwrite(normals, sizeof(glm::vec3), count, fileOut) == count;
+	ok = fclose(fileOut) == 0 && ok;
+	if (ok)
+	{
+		remove(fileName.c_str()); // rename does not replace an existing file on Windows
+		ok = rename(tempName.c_str(), fileName.c_str()) == 0;
+	}
+
+	if (!ok)
+	{
+		remove(tempName.c_str());
+		printf("writeTangentPlaneCache error:  failed writing %s\n", fileName.c_str());
+	}
+	return ok;
+}
+
+#endif
@@ -0,0 +1,40 @@
+/*
+timer.hpp
+
+Wall clock timing from std::chrono::steady_clock, independent of GLUT so it
+can be used by headless runs and the benchmark.
+
+elapsedTime() is milliseconds since the first call.
+percentile(values, p) is the nearest-rank p-th percentile (0 <= p <= 100),
+median(values) the middle value (mean of the two middle values for an even
+count).  Both take a copy and sort it; an empty vector gives 0.
+*/
+
+#ifndef __TIMER__
+#define __TIMER__
+
+#include <chrono>
+
+inline double elapsedTime()
+{
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline double percentile(std::vector<double> values, double p)
+{
+	if (values.empty()) return 0.0;
+	std::sort(values.begin(), values.end());
+	int rank = (int)std::ceil(p / 100.0 * values.size());
+	return values[std::min(std::max(rank, 1), (int)values.size()) - 1];
+}
+
+inline double median(std::vector<double> values)
+{
+	if (values.empty()) return 0.0;
+	std::sort(values.begin(), values.end());
+	size_t n = values.size();
+	return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+#endif